@@ -0,0 +1,295 @@
+// ==============================================================
+//                         AllocReplay
+//      重放 AllocTrace 记录的分配轨迹, 在真实的分配模式上比较分配器:
+//          alloc_replay <trace> [pool|percpu|malloc] [--threads] [--stats]
+//      pool    GlobalPoolManager, 其余配置取自环境变量(HSPD_HUGEPAGES 等)
+//      percpu  GlobalPoolManager + 每 CPU 缓存
+//      malloc  glibc malloc/free/realloc
+//      默认在一个线程上按时间顺序重放; --threads 为轨迹中的每个线程起一个线程,
+//      跨线程释放的对象等到其分配(或上一次调整)完成后再执行。
+//      轨迹读入后先把地址换成对象编号, 计时只包含分配器调用与首字节写入
+// ==============================================================
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <alloc/AllocTrace.hpp>
+
+namespace {
+
+    enum class Op : uint8_t { Alloc, Free, Realloc };
+
+    struct Event {
+        uint32_t id;
+        uint32_t size;
+        uint32_t oldSize;
+        uint32_t step;      // 该对象之前已执行的操作数, 多线程重放时据此等待
+        uint16_t thread;
+        Op op;
+    };
+
+    struct Trace {
+        std::vector<Event> events;      // 按时间排序
+        std::vector<uint32_t> sizes;    // 每个对象最后的尺寸
+        size_t numThreads = 0;
+        size_t peakBytes = 0;           // 请求字节数的峰值
+    };
+
+    struct Slot {
+        std::atomic<void*> ptr{ nullptr };
+        std::atomic<uint32_t> step{ 0 };
+    };
+
+    std::vector<AllocTraceRecord> readRecords(const char* path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error(std::string("cannot open ") + path);
+        AllocTraceHeader header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || std::memcmp(header.magic, AllocTrace::kMagic, sizeof(header.magic)) != 0) {
+            throw std::runtime_error(std::string(path) + " is not an allocation trace");
+        }
+        if (header.version != AllocTrace::kVersion || header.recordSize != sizeof(AllocTraceRecord)) {
+            throw std::runtime_error(std::string(path) + ": unsupported trace version");
+        }
+        std::vector<AllocTraceRecord> records;
+        AllocTraceRecord r;
+        while (in.read(reinterpret_cast<char*>(&r), sizeof(r))) records.push_back(r);
+        return records;
+    }
+
+    // 按时间排序并把地址换成对象编号; 记录开始之前分配的对象的释放被忽略
+    Trace buildTrace(std::vector<AllocTraceRecord> records) {
+        constexpr uint32_t kNone = UINT32_MAX;
+        std::stable_sort(records.begin(), records.end(),
+                         [](const AllocTraceRecord& a, const AllocTraceRecord& b) { return a.time < b.time; });
+
+        Trace trace;
+        std::unordered_map<uint64_t, uint32_t> live;
+        std::unordered_map<uint16_t, uint32_t> reallocating;
+        std::vector<uint32_t>& sizes = trace.sizes;
+        std::vector<uint32_t> steps;
+        size_t liveBytes = 0;
+
+        auto emit = [&](Event e) {
+            trace.numThreads = std::max<size_t>(trace.numThreads, e.thread + 1);
+            trace.events.push_back(e);
+        };
+        auto allocate = [&](const AllocTraceRecord& r) {
+            uint32_t id = static_cast<uint32_t>(sizes.size());
+            sizes.push_back(r.size);
+            steps.push_back(1);
+            live[r.ptr] = id;
+            liveBytes += r.size;
+            emit(Event{ id, r.size, 0, 0, r.thread, Op::Alloc });
+        };
+
+        for (const AllocTraceRecord& r : records) {
+            switch (r.op) {
+            case AllocOp::Alloc:
+                allocate(r);
+                break;
+            case AllocOp::Free: {
+                auto it = live.find(r.ptr);
+                if (it == live.end()) break;
+                uint32_t id = it->second;
+                live.erase(it);
+                liveBytes -= sizes[id];
+                emit(Event{ id, sizes[id], 0, steps[id]++, r.thread, Op::Free });
+                break;
+            }
+            case AllocOp::ReallocBegin: {
+                auto it = live.find(r.ptr);
+                if (it == live.end()) {
+                    reallocating[r.thread] = kNone;
+                } else {
+                    reallocating[r.thread] = it->second;
+                    live.erase(it);
+                }
+                break;
+            }
+            case AllocOp::ReallocEnd: {
+                auto it = reallocating.find(r.thread);
+                if (it == reallocating.end()) break;
+                uint32_t id = it->second;
+                reallocating.erase(it);
+                if (id == kNone) {
+                    allocate(r);
+                    break;
+                }
+                emit(Event{ id, r.size, sizes[id], steps[id]++, r.thread, Op::Realloc });
+                liveBytes = liveBytes - sizes[id] + r.size;
+                sizes[id] = r.size;
+                live[r.ptr] = id;
+                break;
+            }
+            }
+            trace.peakBytes = std::max(trace.peakBytes, liveBytes);
+        }
+        return trace;
+    }
+
+    struct PoolBackend {
+        static void* allocate(size_t size) { return GlobalPoolManager::instance().allocate(size); }
+        static void deallocate(void* p, size_t size) { GlobalPoolManager::instance().deallocate(p, size); }
+        static void* reallocate(void* p, size_t oldSize, size_t newSize) {
+            return GlobalPoolManager::instance().reallocate(p, oldSize, newSize);
+        }
+    };
+
+    struct MallocBackend {
+        static void* allocate(size_t size) {
+            void* p = std::malloc(size);
+            if (!p) throw std::bad_alloc();
+            return p;
+        }
+        static void deallocate(void* p, size_t) { std::free(p); }
+        static void* reallocate(void* p, size_t, size_t newSize) {
+            void* q = std::realloc(p, newSize);
+            if (!q) throw std::bad_alloc();
+            return q;
+        }
+    };
+
+    // 首字节写入让分配器的页真正被映射, 驻留内存的比较才有意义
+    template <typename Backend>
+    void run(const std::vector<Event>& events, Slot* slots, bool wait) {
+        for (const Event& e : events) {
+            Slot& s = slots[e.id];
+            if (wait) {
+                while (s.step.load(std::memory_order_acquire) != e.step) std::this_thread::yield();
+            }
+            switch (e.op) {
+            case Op::Alloc: {
+                void* p = Backend::allocate(e.size);
+                if (e.size) *static_cast<volatile char*>(p) = 0;
+                s.ptr.store(p, std::memory_order_relaxed);
+                break;
+            }
+            case Op::Free:
+                Backend::deallocate(s.ptr.load(std::memory_order_relaxed), e.size);
+                s.ptr.store(nullptr, std::memory_order_relaxed);
+                break;
+            case Op::Realloc: {
+                void* p = Backend::reallocate(s.ptr.load(std::memory_order_relaxed), e.oldSize, e.size);
+                if (e.size) *static_cast<volatile char*>(p) = 0;
+                s.ptr.store(p, std::memory_order_relaxed);
+                break;
+            }
+            }
+            s.step.store(e.step + 1, std::memory_order_release);
+        }
+    }
+
+    // 返回重放耗时(秒)
+    template <typename Backend>
+    double replay(const Trace& trace, Slot* slots, bool threaded) {
+        std::chrono::steady_clock::time_point begin;
+        if (!threaded) {
+            begin = std::chrono::steady_clock::now();
+            run<Backend>(trace.events, slots, false);
+        } else {
+            std::vector<std::vector<Event>> perThread(trace.numThreads);
+            for (const Event& e : trace.events) perThread[e.thread].push_back(e);
+            std::latch ready(static_cast<ptrdiff_t>(perThread.size()) + 1);
+            std::vector<std::thread> workers;
+            for (const auto& events : perThread) {
+                workers.emplace_back([&events, slots, &ready] {
+                    ready.arrive_and_wait();
+                    run<Backend>(events, slots, true);
+                });
+            }
+            ready.arrive_and_wait();
+            begin = std::chrono::steady_clock::now();
+            for (auto& w : workers) w.join();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        return std::chrono::duration<double>(elapsed).count();
+    }
+
+    // 释放轨迹结束时仍存活的对象, 不计时
+    template <typename Backend>
+    void releaseLive(const Trace& trace, Slot* slots) {
+        for (size_t i = 0; i < trace.sizes.size(); i++) {
+            if (void* p = slots[i].ptr.load(std::memory_order_relaxed)) Backend::deallocate(p, trace.sizes[i]);
+        }
+    }
+
+    size_t residentBytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t pages = 0, resident = 0;
+        statm >> pages >> resident;
+        return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    }
+
+    void usage() {
+        std::cerr << "usage: alloc_replay <trace> [pool|percpu|malloc] [--threads] [--stats]\n";
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    std::string backend = "pool";
+    bool threaded = false;
+    bool stats = false;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads") threaded = true;
+        else if (arg == "--stats") stats = true;
+        else if (arg == "pool" || arg == "percpu" || arg == "malloc") backend = arg;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    try {
+        Trace trace = buildTrace(readRecords(argv[1]));
+        std::vector<Slot> slots(trace.sizes.size());
+        size_t rssBefore = residentBytes();
+
+        // 每 CPU 缓存只对之后创建的池生效, 必须在第一次分配之前设置
+        if (backend == "percpu") ThreadSafeMemoryPool::setPerCpuCaches(true);
+        double seconds = backend == "malloc" ? replay<MallocBackend>(trace, slots.data(), threaded)
+                                             : replay<PoolBackend>(trace, slots.data(), threaded);
+        size_t rssAfter = residentBytes();
+        rusage ru{};
+        ::getrusage(RUSAGE_SELF, &ru);
+
+        std::printf("backend      %s%s\n", backend.c_str(), threaded ? " (threaded)" : "");
+        std::printf("threads      %zu\n", trace.numThreads);
+        std::printf("events       %zu\n", trace.events.size());
+        std::printf("objects      %zu\n", trace.sizes.size());
+        std::printf("peak live    %.1f MiB requested\n", static_cast<double>(trace.peakBytes) / (1 << 20));
+        std::printf("time         %.3f ms, %.1f ns/op\n", seconds * 1e3,
+                    trace.events.empty() ? 0.0 : seconds * 1e9 / static_cast<double>(trace.events.size()));
+        std::printf("rss          %.1f MiB before, %.1f MiB after, %.1f MiB peak\n",
+                    static_cast<double>(rssBefore) / (1 << 20), static_cast<double>(rssAfter) / (1 << 20),
+                    static_cast<double>(ru.ru_maxrss) / 1024);
+        if (stats && backend != "malloc") GlobalPoolManager::instance().dumpStats(std::cout);
+
+        if (backend == "malloc") releaseLive<MallocBackend>(trace, slots.data());
+        else releaseLive<PoolBackend>(trace, slots.data());
+    } catch (const std::exception& e) {
+        std::cerr << "alloc_replay: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
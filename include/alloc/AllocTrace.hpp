@@ -0,0 +1,240 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include "MemoryPool.hpp"
+
+// ==============================================================
+//                          AllocTrace
+//      记录 Allocator 的每一次分配/释放/调整大小, 写成紧凑的二进制文件,
+//      供 bench/AllocReplay 在不同的分配器与池配置上重放:
+//          AllocTrace::start("alloc.trace") ... AllocTrace::stop()
+//          或环境变量 HSPD_ALLOC_TRACE=alloc.trace(进程退出时写完)
+//      每个线程先写入自己的缓冲, 满了再整块 write(); 文件中的记录只在
+//      单个线程内有序, 重放前按时间戳稳定排序。关闭时分配路径只多一次原子读。
+//      分配在返回之后取时间戳, 释放在归还之前取, 因此同一地址被另一个线程
+//      复用时, 排序后的释放一定在重新分配之前
+// ==============================================================
+
+enum class AllocOp : uint8_t {
+    Alloc,
+    Free,
+    ReallocBegin,   // ptr/size 为原地址与原尺寸, 在调整之前记录
+    ReallocEnd,     // ptr/size 为新地址与新尺寸, 紧跟在同一线程的 ReallocBegin 之后
+};
+
+// 文件头之后是连续的记录
+struct AllocTraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+struct AllocTraceRecord {
+    uint64_t time;      // 距 start() 的纳秒
+    uint64_t ptr;
+    uint32_t size;      // 超过 4 GiB 的尺寸记为 UINT32_MAX
+    uint16_t thread;    // 线程第一次记录时分配的编号
+    AllocOp op;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(AllocTraceRecord) == 24);
+
+class AllocTrace {
+public:
+    static constexpr char kMagic[8] = { 'H', 'S', 'P', 'D', 'T', 'R', 'C', '\0' };
+    static constexpr uint32_t kVersion = 1;
+
+    // 分配路径上的判断
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // 打开(截断)文件并开始记录; 已在记录时先结束上一个文件
+    static void start(const char* path) {
+        AllocTrace& self = instance();
+        stop();
+        int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "AllocTrace: open");
+        AllocTraceHeader header{};
+        std::copy(std::begin(kMagic), std::end(kMagic), header.magic);
+        header.version = kVersion;
+        header.recordSize = sizeof(AllocTraceRecord);
+        {
+            std::lock_guard<std::mutex> lock(self.fileMutex_);
+            self.fd_ = fd;
+            self.writeLocked(&header, sizeof(header));
+        }
+        {
+            // 丢弃上一次停止之后残留的记录
+            std::lock_guard<std::mutex> lock(self.buffersMutex_);
+            for (ThreadBuffer* b = self.buffers_; b; b = b->next) {
+                std::lock_guard<SpinLock> bufferLock(b->lock);
+                b->count = 0;
+            }
+        }
+        epoch_.store(clockNs(), std::memory_order_relaxed);
+        static std::once_flag atExit;
+        std::call_once(atExit, [] { std::atexit([] { stop(); }); });
+        enabled_.store(true, std::memory_order_release);
+    }
+
+    // 停止记录, 写出所有线程缓冲中的记录并关闭文件
+    static void stop() {
+        AllocTrace& self = instance();
+        enabled_.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(self.buffersMutex_);
+            for (ThreadBuffer* b = self.buffers_; b; b = b->next) {
+                std::lock_guard<SpinLock> bufferLock(b->lock);
+                self.flushLocked(b);
+            }
+        }
+        std::lock_guard<std::mutex> lock(self.fileMutex_);
+        if (self.fd_ >= 0) {
+            ::close(self.fd_);
+            self.fd_ = -1;
+        }
+    }
+
+    // 当前时间戳, 供需要在操作之前取时间的调用方使用
+    static uint64_t now() { return clockNs() - epoch_.load(std::memory_order_relaxed); }
+
+    static void record(AllocOp op, const void* ptr, size_t size) { record(op, ptr, size, now()); }
+
+    static void record(AllocOp op, const void* ptr, size_t size, uint64_t time) {
+        AllocTrace& self = instance();
+        AllocTraceRecord r{ time, reinterpret_cast<uintptr_t>(ptr),
+                            static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX)), 0, op, 0 };
+        if (tlsDead_) [[unlikely]] {
+            // 线程退出阶段, 缓冲已交还: 直接写出这一条
+            r.thread = tlsThread_;
+            std::lock_guard<std::mutex> lock(self.fileMutex_);
+            self.writeLocked(&r, sizeof(r));
+            return;
+        }
+        BufferOwner& owner = tlsOwner();
+        ThreadBuffer* b = owner.buffer;
+        if (!b) [[unlikely]] b = owner.buffer = self.acquireBuffer();
+        r.thread = b->thread;
+        std::lock_guard<SpinLock> lock(b->lock);
+        b->records[b->count++] = r;
+        if (b->count == kBufferRecords) [[unlikely]] self.flushLocked(b);
+    }
+
+private:
+    static constexpr size_t kBufferRecords = 2048;     // 48 KiB
+
+    struct ThreadBuffer {
+        SpinLock lock;
+        uint16_t thread = 0;
+        bool inUse = false;
+        size_t count = 0;
+        ThreadBuffer* next = nullptr;
+        AllocTraceRecord records[kBufferRecords];
+    };
+
+    // 线程退出时写出并交还缓冲, 之后的记录走 tlsDead_ 路径
+    struct BufferOwner {
+        ThreadBuffer* buffer = nullptr;
+        ~BufferOwner() {
+            tlsDead_ = true;
+            if (!buffer) return;
+            tlsThread_ = buffer->thread;
+            instance().releaseBuffer(buffer);
+        }
+    };
+
+    AllocTrace() = default;
+
+    // 进程唯一, 故意不析构: 其他静态对象析构时仍可能记录
+    static AllocTrace& instance() {
+        static AllocTrace* trace = new (sysAlloc(sizeof(AllocTrace))) AllocTrace();
+        return *trace;
+    }
+
+    static BufferOwner& tlsOwner() {
+        thread_local BufferOwner owner;
+        return owner;
+    }
+
+    ThreadBuffer* acquireBuffer() {
+        std::lock_guard<std::mutex> lock(buffersMutex_);
+        ThreadBuffer* b = buffers_;
+        while (b && b->inUse) b = b->next;
+        if (!b) {
+            b = new (sysAlloc(sizeof(ThreadBuffer))) ThreadBuffer();
+            b->next = buffers_;
+            buffers_ = b;
+        }
+        b->inUse = true;
+        b->thread = nextThread_++;
+        return b;
+    }
+
+    void releaseBuffer(ThreadBuffer* b) {
+        std::lock_guard<std::mutex> lock(buffersMutex_);
+        std::lock_guard<SpinLock> bufferLock(b->lock);
+        flushLocked(b);
+        b->inUse = false;
+    }
+
+    // 调用方持有 b->lock
+    void flushLocked(ThreadBuffer* b) {
+        if (b->count == 0) return;
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        writeLocked(b->records, b->count * sizeof(AllocTraceRecord));
+        b->count = 0;
+    }
+
+    // 调用方持有 fileMutex_; 未打开文件时丢弃
+    void writeLocked(const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        while (fd_ >= 0 && bytes > 0) {
+            ssize_t n = ::write(fd_, p, bytes);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            p += n;
+            bytes -= static_cast<size_t>(n);
+        }
+    }
+
+    static uint64_t clockNs() {
+        auto d = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+
+    static bool startFromEnv() {
+        const char* path = std::getenv("HSPD_ALLOC_TRACE");
+        if (!path || !*path) return false;
+        try {
+            start(path);
+        } catch (const std::system_error& e) {
+            std::fprintf(stderr, "%s: %s\n", e.what(), path);
+        }
+        return enabled();
+    }
+
+    std::mutex fileMutex_;
+    int fd_ = -1;
+
+    std::mutex buffersMutex_;
+    ThreadBuffer* buffers_ = nullptr;
+    uint16_t nextThread_ = 0;
+
+    static inline std::atomic<bool> enabled_{ false };
+    static inline std::atomic<uint64_t> epoch_{ 0 };
+    static inline const bool envStarted_ = startFromEnv();
+    static inline thread_local bool tlsDead_ = false;
+    static inline thread_local uint16_t tlsThread_ = 0;
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <memory_resource>
+#include "MemoryPool.hpp"
+
+namespace hspd {
+
+// ==============================================================
+//                            Arena
+//      单调增长的 bump 分配器, 内存块从 GlobalPoolManager 取得并串成链表。
+//      deallocate 什么都不做, reset() 只把游标拨回第一块, O(1);
+//      已经取得的块全部保留给下一轮复用, 析构或 release() 时才归还。
+//      非线程安全, 适合一次请求内的所有临时对象
+// ==============================================================
+
+class Arena final : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kDefaultBlockSize = 4096;
+    static constexpr size_t kMaxBlockSize = 64 * 1024;
+
+    explicit Arena(size_t blockSize = kDefaultBlockSize)
+        : blockSize_(blockSize < sizeof(Block) * 2 ? sizeof(Block) * 2 : blockSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() override { freeBlocks(head_); }
+
+    // 在 arena 中构造对象; arena 不会调用它的析构函数
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // 回到第一块的起点, 之前分配的内存全部失效
+    void reset() {
+        current_ = head_;
+        if (head_) {
+            ptr_ = head_->data();
+            end_ = head_->end();
+        }
+    }
+
+    // reset 并把第一块之外的块还给内存池, 防止一次大请求后长期占用内存
+    void release() {
+        if (head_) {
+            freeBlocks(head_->next);
+            head_->next = nullptr;
+        }
+        reset();
+    }
+
+private:
+    struct alignas(std::max_align_t) Block {
+        Block* next;
+        size_t size;    // 含 Block 头的总字节数
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+        char* end() { return reinterpret_cast<char*>(this) + size; }
+    };
+
+    void* do_allocate(size_t bytes, size_t align) override {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(ptr_) + align - 1) & ~(align - 1);
+        if (p + bytes <= reinterpret_cast<uintptr_t>(end_)) [[likely]] {
+            ptr_ = reinterpret_cast<char*>(p + bytes);
+            return reinterpret_cast<void*>(p);
+        }
+        return allocateSlow(bytes, align);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    // 当前块放不下: 先试 reset 前保留下来的下一块, 否则取一块新的接在当前块之后
+    [[gnu::noinline]] void* allocateSlow(size_t bytes, size_t align) {
+        size_t need = sizeof(Block) + bytes + (align > alignof(Block) ? align : 0);
+        Block* next = current_ ? current_->next : head_;
+        if (!next || next->size < need) {
+            size_t size = current_ ? std::min(current_->size * 2, kMaxBlockSize) : blockSize_;
+            if (size < need) size = need;
+            // 尺寸取 16 的倍数, 对应 size-class 的块地址才能满足 Block 的对齐
+            size = (size + alignof(Block) - 1) & ~(alignof(Block) - 1);
+            Block* block = static_cast<Block*>(GlobalPoolManager::instance().allocate(size));
+            block->size = size;
+            block->next = next;
+            if (current_) current_->next = block;
+            else head_ = block;
+            next = block;
+        }
+        current_ = next;
+        ptr_ = next->data();
+        end_ = next->end();
+        return do_allocate(bytes, align);
+    }
+
+    static void freeBlocks(Block* block) {
+        while (block) {
+            Block* next = block->next;
+            GlobalPoolManager::instance().deallocate(block, block->size);
+            block = next;
+        }
+    }
+
+    size_t blockSize_;
+    Block* head_ = nullptr;
+    Block* current_ = nullptr;
+    char* ptr_ = nullptr;
+    char* end_ = nullptr;
+};
+
+} // namespace hspd
@@ -0,0 +1,247 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <ostream>
+#include <execinfo.h>
+#include "PageHeap.hpp"
+
+// ==============================================================
+//                         HeapProfiler
+//      采样式堆分析: 平均每分配 interval 字节抽取一次, 记录调用栈。
+//      每个线程维护一个字节倒计数, 间隔取指数分布, 未命中时分配路径上
+//      只多一次减法; 输出 pprof 可读的 heap_v2 文本格式:
+//          pprof -inuse_space ./app heap.prof  (当前存活)
+//          pprof -alloc_space ./app heap.prof  (累计分配)
+//      采样到的对象由 GlobalPoolManager 单独从 PageHeap 分配,
+//      释放时通过 PageHeap 路径识别。元数据全部来自 mmap
+// ==============================================================
+
+class HeapProfiler {
+public:
+    static constexpr int kMaxDepth = 32;
+
+    // 进程唯一, 故意不析构
+    static HeapProfiler& instance() {
+        static HeapProfiler* profiler = new (sysAlloc(sizeof(HeapProfiler))) HeapProfiler();
+        return *profiler;
+    }
+
+    HeapProfiler(const HeapProfiler&) = delete;
+    HeapProfiler& operator=(const HeapProfiler&) = delete;
+
+    // 0 表示关闭; 默认取环境变量 HSPD_HEAP_SAMPLE(字节)
+    static void setSampleInterval(size_t bytes) {
+        if (bytes) {
+            // backtrace() 第一次调用时会加载 libgcc_s 并分配内存, 先在采样路径之外完成
+            void* frame;
+            ::backtrace(&frame, 1);
+        }
+        interval_.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t sampleInterval() { return interval_.load(std::memory_order_relaxed); }
+
+    // 分配路径上的判断: 本线程的倒计数耗尽时返回 true
+    static bool shouldSample(size_t size) {
+        if (interval_.load(std::memory_order_relaxed) == 0) [[likely]] return false;
+        tlsCountdown_ -= static_cast<int64_t>(size);
+        if (tlsCountdown_ >= 0) [[likely]] return false;
+        return countdownExpired(size);
+    }
+
+    // 有存活的采样对象时, 释放路径才需要查表
+    static bool hasLiveSamples() { return liveSamples_.load(std::memory_order_relaxed) != 0; }
+
+    // 重新抽取下一次采样的间隔; 返回 false 表示本次不应采样(间隔已关闭或正在采样中递归分配)
+    bool beginSample() {
+        size_t interval = interval_.load(std::memory_order_relaxed);
+        if (interval == 0 || tlsInSample_) {
+            tlsCountdown_ = interval ? static_cast<int64_t>(interval) : kUnarmed;
+            return false;
+        }
+        tlsCountdown_ = nextInterval(interval);
+        tlsInSample_ = true;
+        return true;
+    }
+
+    // 在 beginSample() 返回 true 之后调用, p 为 nullptr 表示分配失败
+    void endSample(void* p, size_t size) {
+        if (p) {
+            void* stack[kMaxDepth];
+            int depth = ::backtrace(stack, kMaxDepth);
+            record(p, size, stack, depth);
+        }
+        tlsInSample_ = false;
+    }
+
+    // p 是采样对象时移出存活集合并返回 true
+    bool recordFree(void* p) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Sample** slot = &samples_[hashPointer(p)];
+        for (Sample* s = *slot; s; slot = &s->next, s = s->next) {
+            if (s->ptr != p) continue;
+            s->bucket->inuseCount--;
+            s->bucket->inuseBytes -= s->size;
+            *slot = s->next;
+            sampleAllocator_.deallocate(s);
+            liveSamples_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // 输出 pprof heap_v2 格式; 先在锁内复制统计, 写出时的内存分配不会与采样路径互锁
+    void writeProfile(std::ostream& os) {
+        size_t n = 0;
+        Bucket* snapshot = nullptr;
+        size_t bytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bytes = std::max<size_t>(numBuckets_, 1) * sizeof(Bucket);
+            snapshot = static_cast<Bucket*>(sysAlloc(bytes));
+            for (Bucket* b : buckets_) {
+                for (; b; b = b->next) snapshot[n++] = *b;
+            }
+        }
+
+        Bucket total{};
+        for (size_t i = 0; i < n; i++) {
+            total.inuseCount += snapshot[i].inuseCount;
+            total.inuseBytes += snapshot[i].inuseBytes;
+            total.allocCount += snapshot[i].allocCount;
+            total.allocBytes += snapshot[i].allocBytes;
+        }
+        os << "heap profile: ";
+        writeCounts(os, total);
+        os << " @ heap_v2/" << sampleInterval() << "\n";
+        for (size_t i = 0; i < n; i++) {
+            writeCounts(os, snapshot[i]);
+            os << " @";
+            for (int d = 0; d < snapshot[i].depth; d++) os << " " << snapshot[i].stack[d];
+            os << "\n";
+        }
+        sysFree(snapshot, bytes);
+
+        // pprof 靠这一段把地址映射回可执行文件与动态库中的符号
+        os << "\nMAPPED_LIBRARIES:\n";
+        std::ifstream maps("/proc/self/maps");
+        os << maps.rdbuf();
+    }
+
+private:
+    HeapProfiler() = default;
+
+    // 同一调用栈的统计
+    struct Bucket {
+        uint64_t hash;
+        int depth;
+        void* stack[kMaxDepth];
+        size_t inuseCount;
+        size_t inuseBytes;
+        size_t allocCount;
+        size_t allocBytes;
+        Bucket* next;
+    };
+
+    // 一个存活的采样对象
+    struct Sample {
+        void* ptr;
+        size_t size;
+        Bucket* bucket;
+        Sample* next;
+    };
+
+    static constexpr size_t kBucketTableSize = 4096;
+    static constexpr size_t kSampleTableSize = 4096;
+
+    static void writeCounts(std::ostream& os, const Bucket& b) {
+        os << b.inuseCount << ": " << b.inuseBytes << " [" << b.allocCount << ": " << b.allocBytes << "]";
+    }
+
+    static size_t hashPointer(const void* p) {
+        return (reinterpret_cast<uintptr_t>(p) >> 4) * 0x9E3779B97F4A7C15ull >> 52;
+    }
+
+    void record(void* p, size_t size, void** stack, int depth) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (int i = 0; i < depth; i++) {
+            hash = (hash ^ reinterpret_cast<uintptr_t>(stack[i])) * 0x100000001b3ull;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Bucket*& head = buckets_[hash % kBucketTableSize];
+        Bucket* b = head;
+        while (b && !(b->hash == hash && b->depth == depth &&
+                      std::equal(stack, stack + depth, b->stack))) {
+            b = b->next;
+        }
+        if (!b) {
+            b = new (bucketAllocator_.allocate()) Bucket{};
+            b->hash = hash;
+            b->depth = depth;
+            std::copy(stack, stack + depth, b->stack);
+            b->next = head;
+            head = b;
+            numBuckets_++;
+        }
+        b->inuseCount++;
+        b->inuseBytes += size;
+        b->allocCount++;
+        b->allocBytes += size;
+
+        Sample*& slot = samples_[hashPointer(p)];
+        slot = new (sampleAllocator_.allocate()) Sample{ p, size, b, slot };
+        liveSamples_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 倒计数变为负数: 线程第一次经过(或采样关闭后重新打开)时还没有抽取过间隔,
+    // 此时先抽取, 这次分配与其他分配一样按间隔计数, 而不是直接被采样
+    [[gnu::noinline]] static bool countdownExpired(size_t size) {
+        if (tlsCountdown_ > kUnarmed / 2) return true;
+        size_t interval = interval_.load(std::memory_order_relaxed);
+        if (interval == 0) {
+            tlsCountdown_ = kUnarmed;
+            return false;
+        }
+        tlsCountdown_ = nextInterval(interval) - static_cast<int64_t>(size);
+        return tlsCountdown_ < 0;
+    }
+
+    // 均值为 interval 的指数分布, 使每个字节被采到的概率相同
+    static int64_t nextInterval(size_t interval) {
+        uint64_t x = tlsRandom_ ? tlsRandom_ : reinterpret_cast<uintptr_t>(&tlsRandom_) | 1;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        tlsRandom_ = x;
+        double u = static_cast<double>((x >> 11) + 1) * 0x1.0p-53;     // (0, 1]
+        double next = -std::log(u) * static_cast<double>(interval);
+        return static_cast<int64_t>(std::min(next, static_cast<double>(interval) * 64)) + 1;
+    }
+
+    static size_t intervalFromEnv() {
+        const char* env = std::getenv("HSPD_HEAP_SAMPLE");
+        return env ? std::strtoull(env, nullptr, 10) : 0;
+    }
+
+    std::mutex mutex_;
+    Bucket* buckets_[kBucketTableSize] = {};
+    Sample* samples_[kSampleTableSize] = {};
+    size_t numBuckets_ = 0;
+    MetadataAllocator<Bucket> bucketAllocator_;
+    MetadataAllocator<Sample> sampleAllocator_;
+
+    static inline std::atomic<size_t> interval_{ intervalFromEnv() };
+    static inline std::atomic<size_t> liveSamples_{0};
+    // 尚未抽取间隔; 离 INT64_MIN 足够远, 减去任何一次分配的尺寸都不会溢出
+    static constexpr int64_t kUnarmed = INT64_MIN / 2;
+    static inline thread_local int64_t tlsCountdown_ = kUnarmed;
+    static inline thread_local uint64_t tlsRandom_ = 0;
+    static inline thread_local bool tlsInSample_ = false;
+};
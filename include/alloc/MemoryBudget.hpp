@@ -0,0 +1,187 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <utility>
+#include <vector>
+#include "MemoryPool.hpp"
+
+// ==============================================================
+//                        MemoryBudget
+//      进程级内存预算: 以 PageHeap 分配出去的字节数为用量, 越过水位
+//      (默认预算的 80% / 95%)时依次调用注册的压力回调, 再 trim 内存池
+//      把空闲内存还给操作系统。PageHeap 的分配路径只负责唤醒, 回调全部
+//      在预算自己的线程上执行, 不会出现在任意一次 malloc 的调用栈里。
+//      回调在用量回落到更低的级别时也会再调用一次
+// ==============================================================
+
+enum class MemoryPressure : uint8_t {
+    Normal,
+    Moderate,   // 越过低水位: 缓存应当收缩
+    Critical,   // 越过高水位: 缓存应当尽量清空
+};
+
+class MemoryBudget {
+public:
+    using Callback = std::function<void(MemoryPressure)>;
+
+    // 进程唯一, 故意不析构
+    static MemoryBudget& instance() {
+        alignas(MemoryBudget) static unsigned char storage[sizeof(MemoryBudget)];
+        static MemoryBudget* budget = new (storage) MemoryBudget();
+        return *budget;
+    }
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    // 设置预算并启动监视线程; limit 为 0 时取 cgroup 的 memory.max, 也没有则不做任何事。
+    // moderate / critical 是相对预算的比例
+    void setLimit(size_t limit, double moderate = 0.8, double critical = 0.95) {
+        if (limit == 0) limit = cgroupLimit();
+        if (limit == 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            moderate_ = static_cast<size_t>(static_cast<double>(limit) * moderate);
+            critical_ = static_cast<size_t>(static_cast<double>(limit) * critical);
+            limit_ = limit;
+            level_ = MemoryPressure::Normal;
+            pending_ = true;
+            stop_ = false;
+        }
+        cv_.notify_one();
+        // 创建线程会分配内存, 可能触发 onWatermark, 不能持有 mutex_
+        std::lock_guard<std::mutex> lock(watcherMutex_);
+        if (!watcher_.joinable()) watcher_ = std::thread([this] { watch(); });
+    }
+
+    // 停止监视线程, 不再检查水位
+    void stop() {
+        PageHeap::instance().setWatermark(SIZE_MAX, nullptr);
+        std::lock_guard<std::mutex> watcherLock(watcherMutex_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (watcher_.joinable()) watcher_.join();
+    }
+
+    // 回调在监视线程上执行, 期间持有回调表的锁: 回调内不能再注册或注销回调,
+    // 注销返回后回调保证不再被调用
+    size_t addCallback(Callback cb) {
+        std::lock_guard<std::mutex> lock(callbacksMutex_);
+        size_t id = nextId_++;
+        callbacks_.push_back({ id, std::move(cb) });
+        return id;
+    }
+
+    void removeCallback(size_t id) {
+        std::lock_guard<std::mutex> lock(callbacksMutex_);
+        for (auto it = callbacks_.begin(); it != callbacks_.end(); ++it) {
+            if (it->first == id) {
+                callbacks_.erase(it);
+                return;
+            }
+        }
+    }
+
+    size_t limit() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return limit_;
+    }
+
+    size_t used() const { return PageHeap::instance().usedBytes(); }
+
+    MemoryPressure level() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return level_;
+    }
+
+    // cgroup v2 的 memory.max, 或 v1 的 memory.limit_in_bytes; 没有限制时返回 0
+    static size_t cgroupLimit() {
+        for (const char* path : { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes" }) {
+            FILE* f = std::fopen(path, "r");
+            if (!f) continue;
+            unsigned long long v = 0;
+            int n = std::fscanf(f, "%llu", &v);
+            std::fclose(f);
+            // "max" 或 v1 中接近 2^63 的值都表示不限制
+            if (n == 1 && v < (1ull << 62)) return static_cast<size_t>(v);
+            return 0;
+        }
+        return 0;
+    }
+
+private:
+    MemoryBudget() = default;
+
+    // 在 PageHeap 的分配路径上调用: 只置位并唤醒监视线程
+    static void onWatermark(size_t) {
+        MemoryBudget& self = instance();
+        PageHeap::instance().setWatermark(SIZE_MAX, &onWatermark);
+        {
+            std::lock_guard<std::mutex> lock(self.mutex_);
+            self.pending_ = true;
+        }
+        self.cv_.notify_one();
+    }
+
+    MemoryPressure classify(size_t used) const {
+        if (used >= critical_) return MemoryPressure::Critical;
+        if (used >= moderate_) return MemoryPressure::Moderate;
+        return MemoryPressure::Normal;
+    }
+
+    // 被唤醒或每隔 kPollInterval 检查一次: 级别变化时调用回调, 升高时再 trim 内存池;
+    // 最后把水位设在当前级别的上一级。trim 之后的回落由下一次检查发现
+    void watch() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            cv_.wait_for(lock, kPollInterval, [this] { return pending_ || stop_; });
+            if (stop_) break;
+            pending_ = false;
+
+            MemoryPressure level = classify(used());
+            if (level != level_) {
+                bool rising = level > level_;
+                level_ = level;
+                lock.unlock();
+                notify(level);
+                if (rising) GlobalPoolManager::instance().trim();
+                lock.lock();
+            }
+            size_t next = level_ == MemoryPressure::Normal ? moderate_
+                        : level_ == MemoryPressure::Moderate ? critical_ : SIZE_MAX;
+            PageHeap::instance().setWatermark(next, &onWatermark);
+        }
+    }
+
+    void notify(MemoryPressure level) {
+        std::lock_guard<std::mutex> lock(callbacksMutex_);
+        for (auto& [id, cb] : callbacks_) cb(level);
+    }
+
+    static constexpr std::chrono::milliseconds kPollInterval{ 1000 };
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::mutex watcherMutex_;
+    std::thread watcher_;
+    bool stop_ = false;
+    bool pending_ = false;
+    size_t limit_ = 0;
+    size_t moderate_ = SIZE_MAX;
+    size_t critical_ = SIZE_MAX;
+    MemoryPressure level_ = MemoryPressure::Normal;
+
+    std::mutex callbacksMutex_;
+    std::vector<std::pair<size_t, Callback>> callbacks_;
+    size_t nextId_ = 1;
+};
@@ -1,173 +1,1493 @@
 #pragma once
 #include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <new>
 #include <mutex>
-#include <vector>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <exception>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <sched.h>
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#endif
+#include "PageHeap.hpp"
+#include "HeapProfiler.hpp"
+
+// ==============================================================
+//                         SpinLock
+//            临界区只有几条指令时比 std::mutex 更轻。
+//     持有者被抢占时(例如每 CPU 缓存上同一 CPU 的其他线程)继续空转
+//     只会耗尽时间片, 自旋 kSpinLimit 次仍未释放就 sched_yield() 让出 CPU
+// ==============================================================
+
+class SpinLock {
+public:
+    void lock() noexcept {
+        while (flag_.test_and_set(std::memory_order_acquire)) {
+            for (int spins = 0; flag_.test(std::memory_order_relaxed); spins++) {
+                if (spins < kSpinLimit) {
+#if defined(__x86_64__) || defined(__i386__)
+                    __builtin_ia32_pause();
+#endif
+                } else {
+                    sched_yield();
+                }
+            }
+        }
+    }
+
+    bool try_lock() noexcept { return !flag_.test_and_set(std::memory_order_acquire); }
+
+    void unlock() noexcept { flag_.clear(std::memory_order_release); }
+
+private:
+    static constexpr int kSpinLimit = 128;
+
+    std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+};
+
+// ==============================================================
+//                        OwnerCounter
+//     只由一个线程写、其他线程可以随时读的计数器: relaxed 的 load + store,
+//     在 x86 上与普通变量生成相同的指令, 读端不需要加锁
+// ==============================================================
+
+class OwnerCounter {
+public:
+    OwnerCounter(size_t v = 0) noexcept : v_(v) {}
+    OwnerCounter& operator=(size_t v) noexcept { v_.store(v, std::memory_order_relaxed); return *this; }
+    operator size_t() const noexcept { return v_.load(std::memory_order_relaxed); }
+
+    OwnerCounter& operator+=(size_t n) noexcept { return *this = *this + n; }
+    OwnerCounter& operator-=(size_t n) noexcept { return *this = *this - n; }
+    size_t operator++() noexcept { size_t v = *this + 1; *this = v; return v; }
+    size_t operator--() noexcept { size_t v = *this - 1; *this = v; return v; }
+    size_t operator++(int) noexcept { size_t v = *this; *this = v + 1; return v; }
+
+private:
+    std::atomic<size_t> v_;
+};
+
+// ThreadSafeMemoryPool::stats() 的结果; 计数在读取时从各缓存汇总, 并发读写下只是近似值
+struct PoolStats {
+    size_t blockSize = 0;
+    size_t chunkBytes = 0;
+    size_t blocksPerChunk = 0;
+    size_t cacheLimit = 0;          // 线程缓存上限 localCacheLimit_, 超过两倍时溢出一批
+    uint64_t allocs = 0;
+    uint64_t frees = 0;
+    uint64_t cacheMisses = 0;       // 分配时本地缓存为空的次数
+    uint64_t centralRefills = 0;    // 从中心缓存取回的批数
+    uint64_t centralFlushes = 0;    // 交还中心缓存的批数
+    uint64_t remoteFrees = 0;       // 释放到其他线程缓存的块数
+    size_t chunks = 0;
+    size_t bytesReserved = 0;       // chunks * chunkBytes
+    size_t bytesInUse = 0;          // (allocs - frees) * blockSize
+    size_t caches = 0;              // 活跃的线程缓存数, 或每 CPU 缓存的份数
+    size_t cachedBlocks = 0;        // 各缓存持有的空闲块总数
+    size_t maxCachedBlocks = 0;     // 单个缓存持有的最多空闲块数
+    size_t centralBlocks = 0;       // 中心缓存中的空闲块数
+
+    double hitRate() const { return allocs ? 1.0 - double(cacheMisses) / double(allocs) : 0.0; }
+};
+
+// ==============================================================
+//                         当前 CPU
+//     glibc 2.35 起为每个线程注册 rseq, 内核在线程每次被调度时更新
+//     其中的 cpu_id, 读取当前 CPU 只需一次 TLS 访问, 不进入内核
+// ==============================================================
+
+// rseq 未注册(glibc 过旧、GLIBC_TUNABLES=glibc.pthread.rseq=0 或线程正在退出)时返回 -1
+inline int currentCpu() noexcept {
+#if defined(RSEQ_SIG) && (defined(__x86_64__) || defined(__aarch64__))
+    if (__rseq_size == 0) return -1;
+    auto* rs = reinterpret_cast<const volatile struct rseq*>(
+        static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+    return static_cast<int>(rs->cpu_id);
+#else
+    return -1;
+#endif
+}
+
+// 进程可用 CPU 编号的上界; 只用系统调用, 不经过 malloc
+inline size_t possibleCpus() noexcept {
+    static const size_t n = [] {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) return size_t(1);
+        size_t last = 0;
+        for (size_t i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &set)) last = i;
+        }
+        return last + 1;
+    }();
+    return n;
+}
 
 // ==============================================================
 //                    ThreadSafeMemoryPool
-//        固定块尺寸 + 多线程安全 + thread_local 缓存
+//        固定块尺寸 + 多线程安全 + 每池每线程缓存 + 远程释放
 // ==============================================================
+//
+// 每个线程在每个池中拥有独立的 ThreadCache, 不同尺寸的块不会混在一起。
+// chunk 按 2 的幂对齐, 起始处放 ChunkHeader 记录切分它的 ThreadCache(owner)。
+// 在非 owner 线程上释放的块先攒成批, 再用一次 CAS 挂到 owner 的 remoteHead,
+// owner 在本地缓存耗尽时一次性取走整条链表, 整个过程不经过 globalMutex_。
+//
+// 线程缓存与全局之间隔着一层中心缓存(transfer cache): 每批恰好 batchSize_
+// 个块, 预先用块内 next 指针串好, 存进按线程分片的 slot 数组, 一次 refill
+// 或 flush 在自旋锁内只做一次指针存取。slot 放满后才溢出到 globalMutex_
+// 保护的侵入式链表。
+//
+// chunk 从 PageHeap 按自身大小对齐分配。trim() 统计每个 chunk 仍在中心缓存
+// 之外的块数(liveBlocks), 将 liveBlocks 为 0 的 chunk 还给 PageHeap, 再由
+// PageHeap 把物理页归还给操作系统。线程缓存记录两次扫描之间的最低水位,
+// 扫描纪元推进后由所属线程把一半从未用到的块交回中心缓存。
+//
+// 所有空闲链表都是侵入式的: next 指针存放在空闲块自身的前 8 个字节, 整批
+// 拼接只需改首尾指针。ThreadCache、线程表与注册表都直接从 mmap 分配,
+// 分配器内部不调用 malloc/new。
+//
+// 每 CPU 缓存模式(setPerCpuCaches(true) 或环境变量 HSPD_PERCPU=1, 对之后创建的池生效):
+// 线程缓存换成每个 CPU 一份的缓存, 由 rseq 读出的 cpu_id 选择, 缓存占用随核数
+// 而不是线程数增长。同一时刻一个 CPU 上只运行一个线程, 每份缓存的自旋锁只在
+// 持锁线程被抢占或迁移时才会发生争用。此模式下 chunk 不属于任何线程, 没有远程释放;
+// rseq 不可用时该池退回线程缓存。
 
 class ThreadSafeMemoryPool {
 public:
-    ThreadSafeMemoryPool(size_t blockSize, size_t blocksPerChunk = 1024, size_t localCacheLimit = 64)
-        : blockSize_(alignBlockSize(blockSize)),
-          blocksPerChunk_(blocksPerChunk),
-          localCacheLimit_(localCacheLimit)
+    // sizeClassTag 非 0 时, chunk 的每一页都在 PageHeap 中登记为该值, 供不带尺寸的释放查找所属的池;
+    // blockAlign(2 的幂)大于 8 时, 块尺寸取其整数倍, chunk 头也扩大到 blockAlign, 每个块都按它对齐
+    ThreadSafeMemoryPool(size_t blockSize, size_t blocksPerChunk = 1024, size_t localCacheLimit = 64,
+                         uint8_t sizeClassTag = 0, size_t blockAlign = 8)
+        : blockSize_(alignBlockSize(blockSize, blockAlign)),
+          chunkAlign_(chunkAlignFor(blockSize_, blocksPerChunk, headerSizeFor(blockAlign))),
+          blocksPerChunk_((chunkAlign_ - headerSizeFor(blockAlign)) / blockSize_),
+          localCacheLimit_(localCacheLimit),
+          batchSize_(std::max<size_t>(localCacheLimit, 1)),
+          headerSize_(headerSizeFor(blockAlign)),
+          sizeClassTag_(sizeClassTag)
     {
         assert(blockSize_ >= sizeof(void*) && "blockSize must be >= pointer size");
+        assert((blockAlign & (blockAlign - 1)) == 0 && blockAlign <= kPageSize);
+        orphan_.active.store(false, std::memory_order_relaxed);
+        if (perCpuCachesEnabled() && currentCpu() >= 0) {
+            numCpus_ = possibleCpus();
+            cpuCaches_ = new (sysAlloc(numCpus_ * sizeof(CpuCache))) CpuCache[numCpus_];
+        }
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        id_ = reg.count++;
+        reg.pools.ensure(reg.count);
+        reg.pools[id_] = this;
     }
 
+    ThreadSafeMemoryPool(const ThreadSafeMemoryPool&) = delete;
+    ThreadSafeMemoryPool& operator=(const ThreadSafeMemoryPool&) = delete;
+
     ~ThreadSafeMemoryPool() {
-        for (void* c : chunks_) {
-            ::operator delete(c);
+        {
+            // 先从注册表摘除, 之后退出的线程不会再访问本池
+            auto& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mtx);
+            reg.pools[id_] = nullptr;
+            ThreadCache* tc = caches_;
+            while (tc) {
+                ThreadCache* next = tc->next;
+                tc->~ThreadCache();
+                reg.cacheAllocator.deallocate(tc);
+                tc = next;
+            }
         }
+        ChunkHeader* c = chunkList_;
+        while (c) {
+            ChunkHeader* next = c->next;
+            PageHeap::instance().deallocate(c);
+            c = next;
+        }
+        if (cpuCaches_) sysFree(cpuCaches_, numCpus_ * sizeof(CpuCache));
     }
 
-    void* allocate() {
-        auto &local = localCache();
-        if (!local.empty()) {
-            void* p = local.back();
-            local.pop_back();
-            return p;
-        }
+    // 之后创建的池使用每 CPU 缓存; 默认取环境变量 HSPD_PERCPU
+    static void setPerCpuCaches(bool enable) {
+        perCpuSetting_.store(enable ? 1 : 0, std::memory_order_relaxed);
+    }
 
-        refillLocalFromGlobal(local);
+    static bool perCpuCachesEnabled() {
+        int v = perCpuSetting_.load(std::memory_order_relaxed);
+        if (v >= 0) return v != 0;
+        static const bool fromEnv = [] {
+            const char* env = std::getenv("HSPD_PERCPU");
+            return env && std::strcmp(env, "1") == 0;
+        }();
+        return fromEnv;
+    }
 
-        if (!local.empty()) {
-            void* p = local.back();
-            local.pop_back();
-            return p;
-        }
+    bool usesPerCpuCaches() const { return cpuCaches_ != nullptr; }
+
+    void* allocate() {
+        if (cpuCaches_) return allocatePerCpu();
+        if (tlsDead_) [[unlikely]] return allocateSlow();
 
-        allocateChunkToLocal(local);
-        void* p = local.back();
-        local.pop_back();
+        ThreadCache* tc = threadCache();
+        if (!tc->head) [[unlikely]] {
+            refillLocal(tc);
+        }
+        void* p = tc->head;
+        tc->head = nextOf(p);
+        if (--tc->count < tc->lowWater) tc->lowWater = tc->count;
+        tc->allocs++;
         return p;
     }
 
     void deallocate(void* p) {
         if (!p) return;
-        auto &local = localCache();
-        local.push_back(p);
+        if (cpuCaches_) {
+            deallocatePerCpu(p);
+            return;
+        }
+        if (tlsDead_) [[unlikely]] {
+            deallocateSlow(p);
+            return;
+        }
+
+        ThreadCache* tc = threadCache();
+        tc->frees++;
+        ThreadCache* owner = chunkOf(p)->owner;
+        if (owner != tc && owner->active.load(std::memory_order_relaxed)) {
+            remoteFree(tc, owner, p);
+            return;
+        }
+
+        setNext(p, tc->head);
+        tc->head = p;
+        if (++tc->count > localCacheLimit_ * 2) [[unlikely]] {
+            flushLocalToGlobal(tc);
+        }
+        if (tc->epoch != scavengeEpoch_.load(std::memory_order_relaxed)) [[unlikely]] {
+            decay(tc);
+        }
+    }
+
+    // 一次取 n 个块写入 out: 线程缓存只查找一次, 本地链表整段摘下, 不够时按批从中心缓存补充。
+    // 分配失败时已取得的块全部归还, 再抛出异常
+    template <typename T>
+    void allocateBatch(T** out, size_t n) {
+        if (cpuCaches_) {
+            allocateBatchPerCpu(out, n);
+            return;
+        }
+        if (tlsDead_) [[unlikely]] {
+            for (size_t i = 0; i < n; i++) out[i] = static_cast<T*>(allocateSlow());
+            return;
+        }
+
+        ThreadCache* tc = threadCache();
+        size_t i = 0;
+        try {
+            while (i < n) {
+                if (!tc->head) refillLocal(tc);
+                size_t take = std::min<size_t>(n - i, tc->count);
+                void* p = tc->head;
+                for (size_t k = 0; k < take; k++) {
+                    out[i++] = static_cast<T*>(p);
+                    p = nextOf(p);
+                }
+                tc->head = p;
+                tc->count -= take;
+            }
+        } catch (...) {
+            deallocateBatch(out, i);
+            throw;
+        }
+        if (tc->count < tc->lowWater) tc->lowWater = tc->count;
+        tc->allocs += n;
+    }
+
+    // 一次归还 n 个块(可含 nullptr): 本线程的块先全部挂到本地链表, 最后统一按批溢出到中心缓存
+    template <typename T>
+    void deallocateBatch(T* const* ptrs, size_t n) {
+        if (cpuCaches_) {
+            deallocateBatchPerCpu(ptrs, n);
+            return;
+        }
+        if (tlsDead_) [[unlikely]] {
+            for (size_t i = 0; i < n; i++) {
+                if (ptrs[i]) deallocateSlow(ptrs[i]);
+            }
+            return;
+        }
+
+        ThreadCache* tc = threadCache();
+        for (size_t i = 0; i < n; i++) {
+            void* p = ptrs[i];
+            if (!p) continue;
+            tc->frees++;
+            ThreadCache* owner = chunkOf(p)->owner;
+            if (owner != tc && owner->active.load(std::memory_order_relaxed)) {
+                remoteFree(tc, owner, p);
+                continue;
+            }
+            setNext(p, tc->head);
+            tc->head = p;
+            tc->count++;
+        }
+        while (tc->count > localCacheLimit_ * 2) {
+            flushLocalToGlobal(tc);
+        }
+        if (tc->epoch != scavengeEpoch_.load(std::memory_order_relaxed)) [[unlikely]] {
+            decay(tc);
+        }
+    }
+
+    // 汇总各缓存的计数; 只读取计数与链表长度, 不持有任何锁时分配内存
+    PoolStats stats() {
+        PoolStats st;
+        st.blockSize = blockSize_;
+        st.chunkBytes = chunkAlign_;
+        st.blocksPerChunk = blocksPerChunk_;
+        st.cacheLimit = localCacheLimit_;
+        st.allocs = slowAllocs_.load(std::memory_order_relaxed);
+        st.frees = slowFrees_.load(std::memory_order_relaxed);
 
-        if (local.size() > localCacheLimit_ * 2) {
-            flushLocalToGlobal(local);
+        auto addCache = [&](size_t allocs, size_t frees, size_t misses, size_t refills,
+                            size_t flushes, size_t remote, size_t cached) {
+            st.allocs += allocs;
+            st.frees += frees;
+            st.cacheMisses += misses;
+            st.centralRefills += refills;
+            st.centralFlushes += flushes;
+            st.remoteFrees += remote;
+            st.cachedBlocks += cached;
+            st.maxCachedBlocks = std::max(st.maxCachedBlocks, cached);
+        };
+        if (cpuCaches_) {
+            st.caches = numCpus_;
+            for (size_t i = 0; i < numCpus_; i++) {
+                CpuCache& c = cpuCaches_[i];
+                std::lock_guard<SpinLock> lock(c.lock);
+                addCache(c.allocs, c.frees, c.misses, c.misses, c.flushes, 0, c.count);
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(cachesMutex_);
+            for (ThreadCache* tc = caches_; tc; tc = tc->next) {
+                if (tc->active.load(std::memory_order_relaxed)) st.caches++;
+                addCache(tc->allocs, tc->frees, tc->misses, tc->refills, tc->flushes, tc->remoteFrees, tc->count);
+            }
         }
+
+        for (auto& shard : shards_) st.centralBlocks += shard.used.load(std::memory_order_relaxed) * batchSize_;
+        {
+            std::lock_guard<std::mutex> lock(globalMutex_);
+            st.centralBlocks += globalFreeCount_;
+        }
+        {
+            std::lock_guard<std::mutex> lock(chunksMutex_);
+            st.chunks = numChunks_;
+        }
+        st.bytesReserved = st.chunks * chunkAlign_;
+        st.bytesInUse = st.allocs > st.frees ? (st.allocs - st.frees) * blockSize_ : 0;
+        return st;
+    }
+
+    // 回收所有块都已回到中心缓存的 chunk, 返回交还给 PageHeap 的字节数
+    size_t trim() {
+        ChunkHeader* reclaimed = nullptr;
+        {
+            for (auto& shard : shards_) shard.lock.lock();
+            std::lock_guard<std::mutex> globalLock(globalMutex_);
+            std::lock_guard<std::mutex> chunksLock(chunksMutex_);
+
+            for (ChunkHeader* c = chunkList_; c; c = c->next) {
+                c->liveBlocks = blocksPerChunk_;
+            }
+
+            // 取出中心缓存中的全部块, 同时扣减所属 chunk 的 liveBlocks
+            void* all = nullptr;
+            auto collect = [&](void* p) {
+                while (p) {
+                    void* next = nextOf(p);
+                    setNext(p, all);
+                    all = p;
+                    chunkOf(p)->liveBlocks--;
+                    p = next;
+                }
+            };
+            for (auto& shard : shards_) {
+                size_t used = shard.used.load(std::memory_order_relaxed);
+                for (size_t i = 0; i < used; i++) collect(shard.slots[i]);
+                shard.used.store(0, std::memory_order_relaxed);
+            }
+            collect(globalFreeList_);
+            globalFreeList_ = nullptr;
+            globalFreeCount_ = 0;
+
+            for (ChunkHeader* c = chunkList_; c; ) {
+                ChunkHeader* next = c->next;
+                if (c->liveBlocks == 0) {
+                    unlinkChunk(c);
+                    numChunks_--;
+                    c->next = reclaimed;
+                    reclaimed = c;
+                }
+                c = next;
+            }
+
+            // 其余块重新串成整批放回, 依次填入各分片
+            size_t shardIdx = 0;
+            auto putBack = [&](void* head, void* tail, size_t n) {
+                if (n == batchSize_) {
+                    while (shardIdx < kTransferShards &&
+                           shards_[shardIdx].used.load(std::memory_order_relaxed) == kTransferSlots) {
+                        shardIdx++;
+                    }
+                    if (shardIdx < kTransferShards) {
+                        auto& shard = shards_[shardIdx];
+                        size_t used = shard.used.load(std::memory_order_relaxed);
+                        shard.slots[used] = head;
+                        shard.used.store(used + 1, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+                setNext(tail, globalFreeList_);
+                globalFreeList_ = head;
+                globalFreeCount_ += n;
+            };
+            void* head = nullptr;
+            void* tail = nullptr;
+            size_t n = 0;
+            for (void* p = all; p; ) {
+                void* next = nextOf(p);
+                if (chunkOf(p)->liveBlocks != 0) {
+                    setNext(p, head);
+                    if (!head) tail = p;
+                    head = p;
+                    if (++n == batchSize_) {
+                        putBack(head, tail, n);
+                        head = tail = nullptr;
+                        n = 0;
+                    }
+                }
+                p = next;
+            }
+            if (n) putBack(head, tail, n);
+
+            for (auto& shard : shards_) shard.lock.unlock();
+        }
+
+        size_t bytes = 0;
+        while (reclaimed) {
+            ChunkHeader* next = reclaimed->next;
+            PageHeap::instance().deallocate(reclaimed);
+            bytes += chunkAlign_;
+            reclaimed = next;
+        }
+        return bytes;
+    }
+
+    // 推进扫描纪元: 各线程在下一次释放时按最低水位收缩自己的缓存
+    static void advanceScavengeEpoch() {
+        scavengeEpoch_.fetch_add(1, std::memory_order_relaxed);
     }
 
+    size_t blockSize() const { return blockSize_; }
+
 private:
-    static size_t alignBlockSize(size_t s) {
-        constexpr size_t align = alignof(std::max_align_t);
+    struct ThreadCache;
+
+    // 位于每个 chunk 的起始处, 占满一条 cache line
+    struct ChunkHeader {
+        ThreadSafeMemoryPool* pool;
+        ThreadCache* owner;
+        // 池内所有 chunk 的双向链表, 由 chunksMutex_ 保护
+        ChunkHeader* prev;
+        ChunkHeader* next;
+        // 上次 trim 时不在中心缓存中的块数(在用或位于线程缓存)
+        size_t liveBlocks;
+    };
+
+    // 第一条 cache line 只由所属线程读写; 其他线程会写的字段放在第二条
+    struct alignas(64) ThreadCache {
+        // 本地空闲链表
+        void* head = nullptr;
+        OwnerCounter count;
+        // 上次收缩以来本地缓存的最低水位, 以及当时的扫描纪元
+        size_t lowWater = 0;
+        uint64_t epoch = 0;
+        // 本线程释放、尚未交还给 pendingOwner 的一批块
+        ThreadCache* pendingOwner = nullptr;
+        void* pendingHead = nullptr;
+        void* pendingTail = nullptr;
+        size_t pendingCount = 0;
+        // 统计, 由 stats() 汇总
+        OwnerCounter allocs;
+        OwnerCounter frees;
+        OwnerCounter misses;
+        OwnerCounter refills;
+        OwnerCounter flushes;
+        OwnerCounter remoteFrees;
+
+        // 其他线程归还给本缓存的块, 以块内 next 指针串成的无锁栈
+        alignas(64) std::atomic<void*> remoteHead{nullptr};
+        std::atomic<bool> active{true};
+        // 优先使用的中心缓存分片
+        size_t shard = 0;
+        // 池内所有缓存的链表, 由 cachesMutex_ 保护
+        ThreadCache* next = nullptr;
+    };
+
+    // 每 CPU 缓存, 字段含义同 ThreadCache 的本地部分
+    struct alignas(64) CpuCache {
+        SpinLock lock;
+        void* head = nullptr;
+        size_t count = 0;
+        size_t lowWater = 0;
+        uint64_t epoch = 0;
+        size_t allocs = 0;
+        size_t frees = 0;
+        size_t misses = 0;
+        size_t flushes = 0;
+    };
+
+    static constexpr size_t kTransferShards = 4;
+    static constexpr size_t kTransferSlots = 64;
+
+    // 中心缓存的一个分片, 每个 slot 是一条恰好 batchSize_ 个块的链表
+    struct alignas(64) TransferShard {
+        SpinLock lock;
+        std::atomic<size_t> used{0};
+        void* slots[kTransferSlots];
+    };
+
+    // 每个线程一张表: 池 id -> 本线程在该池中的缓存
+    struct ThreadCacheTable {
+        SysArray<ThreadCache*> caches;
+        ~ThreadCacheTable() {
+            tlsDead_ = true;
+            releaseThreadCaches(caches);
+        }
+    };
+
+    // 全局池注册表, 用于线程退出时判断池是否仍然存活; 故意不析构
+    struct Registry {
+        std::mutex mtx;
+        SysArray<ThreadSafeMemoryPool*> pools;
+        size_t count = 0;
+        MetadataAllocator<ThreadCache> cacheAllocator;
+    };
+
+    static constexpr size_t kChunkHeaderSize = 64;
+    static_assert(sizeof(ChunkHeader) <= kChunkHeaderSize);
+    static constexpr size_t kRemoteBatch = 32;
+
+    // 块尺寸按 8 字节(或 blockAlign)取整, 块地址按块尺寸自然对齐(最多 alignof(std::max_align_t)):
+    // 24 字节的块只需 8 字节对齐, 因为对齐要求为 16 的类型其 sizeof 必是 16 的倍数
+    static size_t alignBlockSize(size_t s, size_t blockAlign) {
+        size_t align = std::max<size_t>(blockAlign, 8);
         return ((s + align - 1) / align) * align;
     }
 
-    static std::vector<void*>& localCache() {
-        thread_local std::vector<void*> cache;
-        return cache;
+    static size_t headerSizeFor(size_t blockAlign) {
+        return std::max(kChunkHeaderSize, blockAlign);
     }
 
-    void allocateChunkToLocal(std::vector<void*>& local) {
-        size_t chunkBytes = blockSize_ * blocksPerChunk_;
-        void* chunk = ::operator new(chunkBytes);
+    // chunk 按自身大小对齐, 以便从块地址直接找到 ChunkHeader; 至少一页
+    static size_t chunkAlignFor(size_t blockSize, size_t blocksPerChunk, size_t headerSize) {
+        size_t need = headerSize + blockSize * std::max<size_t>(blocksPerChunk, 1);
+        size_t align = kPageSize;
+        while (align < need) align <<= 1;
+        return align;
+    }
+
+    static Registry& registry() {
+        static Registry* reg = new (sysAlloc(sizeof(Registry))) Registry();
+        return *reg;
+    }
+
+    static ThreadCacheTable& tlsTable() {
+        thread_local ThreadCacheTable table;
+        return table;
+    }
+
+    static void* nextOf(void* block) { return *static_cast<void**>(block); }
+    static void setNext(void* block, void* next) { *static_cast<void**>(block) = next; }
+
+    ChunkHeader* chunkOf(void* p) const {
+        return reinterpret_cast<ChunkHeader*>(reinterpret_cast<uintptr_t>(p) & ~(chunkAlign_ - 1));
+    }
+
+    ThreadCache* threadCache() {
+        auto& caches = tlsTable().caches;
+        if (id_ < caches.size() && caches[id_]) [[likely]] {
+            return caches[id_];
+        }
+        return attachThreadCache(caches);
+    }
+
+    // 优先复用已退出线程留下的缓存, 其 remoteHead 上可能还有待回收的块
+    ThreadCache* attachThreadCache(SysArray<ThreadCache*>& caches) {
+        ThreadCache* tc = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(cachesMutex_);
+            for (ThreadCache* c = caches_; c; c = c->next) {
+                if (!c->active.load(std::memory_order_acquire)) {
+                    c->active.store(true, std::memory_order_relaxed);
+                    tc = c;
+                    break;
+                }
+            }
+        }
+        if (!tc) {
+            {
+                auto& reg = registry();
+                std::lock_guard<std::mutex> lock(reg.mtx);
+                tc = new (reg.cacheAllocator.allocate()) ThreadCache();
+            }
+            std::lock_guard<std::mutex> lock(cachesMutex_);
+            tc->shard = numCaches_++ % kTransferShards;
+            tc->next = caches_;
+            caches_ = tc;
+        }
+        caches.ensure(id_ + 1);
+        caches[id_] = tc;
+        return tc;
+    }
+
+    static void releaseThreadCaches(SysArray<ThreadCache*>& caches) {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        for (size_t id = 0; id < caches.size() && id < reg.count; id++) {
+            if (caches[id] && reg.pools[id]) {
+                reg.pools[id]->releaseThreadCache(caches[id]);
+            }
+            caches[id] = nullptr;
+        }
+    }
+
+    // 线程退出: 交还所有块, 缓存本身留给后来的线程复用
+    void releaseThreadCache(ThreadCache* tc) {
+        flushPending(tc);
+        drainRemote(tc);
+        while (tc->count > 0) {
+            releaseBatchFromLocal(tc, std::min<size_t>(batchSize_, tc->count));
+        }
+        tc->lowWater = 0;
+        tc->active.store(false, std::memory_order_release);
+    }
+
+    void remoteFree(ThreadCache* tc, ThreadCache* owner, void* p) {
+        tc->remoteFrees++;
+        if (tc->pendingOwner != owner) {
+            flushPending(tc);
+            tc->pendingOwner = owner;
+        }
+        setNext(p, tc->pendingHead);
+        if (!tc->pendingHead) tc->pendingTail = p;
+        tc->pendingHead = p;
+        if (++tc->pendingCount >= kRemoteBatch) {
+            flushPending(tc);
+        }
+    }
+
+    // 整批挂到 owner 的 remoteHead 上, 只需一次成功的 CAS
+    static void flushPending(ThreadCache* tc) {
+        if (!tc->pendingHead) return;
+        auto& head = tc->pendingOwner->remoteHead;
+        void* old = head.load(std::memory_order_relaxed);
+        do {
+            setNext(tc->pendingTail, old);
+        } while (!head.compare_exchange_weak(old, tc->pendingHead,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+        tc->pendingHead = tc->pendingTail = nullptr;
+        tc->pendingCount = 0;
+        tc->pendingOwner = nullptr;
+    }
+
+    // 一次取走整条远程链表, 拼接到本地链表头部
+    static void drainRemote(ThreadCache* tc) {
+        void* head = tc->remoteHead.exchange(nullptr, std::memory_order_acquire);
+        if (!head) return;
+        void* tail = head;
+        size_t n = 1;
+        while (nextOf(tail)) {
+            tail = nextOf(tail);
+            n++;
+        }
+        setNext(tail, tc->head);
+        tc->head = head;
+        tc->count += n;
+    }
+
+    void refillLocal(ThreadCache* tc) {
+        tc->misses++;
+        drainRemote(tc);
+        if (tc->head) return;
+
+        refillLocalFromGlobal(tc);
+        if (tc->head) return;
+
+        // 新 chunk 的第一批直接成为本地链表: 不经过中心缓存, 其他线程取不走, trim() 也不会回收该 chunk
+        void* head = nullptr;
+        tc->count = allocateChunk(tc, head);
+        tc->head = head;
+        tc->refills++;
+    }
+
+    // 切分新 chunk: 第一批通过 first 交给调用方, 其余整批整批地放进中心缓存; 返回第一批的块数(至少 1)
+    size_t allocateChunk(ThreadCache* owner, void*& first) {
+        void* chunk = PageHeap::instance().allocateAligned(chunkAlign_, chunkAlign_, sizeClassTag_);
+        auto* header = static_cast<ChunkHeader*>(chunk);
+        header->pool = this;
+        header->owner = owner;
+        header->prev = nullptr;
+        header->liveBlocks = blocksPerChunk_;
 
         {
             std::lock_guard<std::mutex> lock(chunksMutex_);
-            chunks_.push_back(chunk);
+            numChunks_++;
+            header->next = chunkList_;
+            if (chunkList_) chunkList_->prev = header;
+            chunkList_ = header;
         }
 
-        for (size_t i = 0; i < blocksPerChunk_; i++) {
-            void* block = static_cast<char*>(chunk) + i * blockSize_;
-            local.push_back(block);
+        char* base = static_cast<char*>(chunk) + headerSize_;
+        size_t firstCount = 0;
+        for (size_t i = 0; i < blocksPerChunk_; i += batchSize_) {
+            size_t n = std::min(batchSize_, blocksPerChunk_ - i);
+            char* head = base + i * blockSize_;
+            for (size_t j = 0; j + 1 < n; j++) {
+                setNext(head + j * blockSize_, head + (j + 1) * blockSize_);
+            }
+            void* last = head + (n - 1) * blockSize_;
+            setNext(last, nullptr);
+            if (i == 0) {
+                first = head;
+                firstCount = n;
+            } else {
+                insertBatch(owner->shard, head, last, n);
+            }
         }
+        return firstCount;
     }
 
-    void refillLocalFromGlobal(std::vector<void*>& local) {
-        std::lock_guard<std::mutex> lock(globalMutex_);
-        size_t toMove = std::min(localCacheLimit_, globalFreeList_.size());
-        for (size_t i = 0; i < toMove; i++) {
-            local.push_back(globalFreeList_.back());
-            globalFreeList_.pop_back();
+    void unlinkChunk(ChunkHeader* c) {
+        if (c->prev) c->prev->next = c->next;
+        else chunkList_ = c->next;
+        if (c->next) c->next->prev = c->prev;
+    }
+
+    // 本地缓存中至少 lowWater 个块在上个周期里从未被用到, 交回其中一半
+    void decay(ThreadCache* tc) {
+        tc->epoch = scavengeEpoch_.load(std::memory_order_relaxed);
+        flushPending(tc);
+        size_t n = std::min<size_t>(tc->lowWater, tc->count) / 2;
+        if (n > 0) releaseBatchFromLocal(tc, n);
+        tc->lowWater = tc->count;
+    }
+
+    // 只在本地链表为空时调用, 整批直接成为本地链表
+    void refillLocalFromGlobal(ThreadCache* tc) {
+        void* head = nullptr;
+        size_t n = removeBatch(tc->shard, head);
+        if (n == 0) return;
+        tc->head = head;
+        tc->count = n;
+        tc->refills++;
+    }
+
+    void flushLocalToGlobal(ThreadCache* tc) {
+        releaseBatchFromLocal(tc, batchSize_);
+    }
+
+    // 在锁外从本地链表头部摘下 n 个块, 再整批交给中心缓存
+    void releaseBatchFromLocal(ThreadCache* tc, size_t n) {
+        void* head = tc->head;
+        void* tail = head;
+        for (size_t i = 1; i < n; i++) tail = nextOf(tail);
+        tc->head = nextOf(tail);
+        tc->count -= n;
+        tc->flushes++;
+        setNext(tail, nullptr);
+        insertBatch(tc->shard, head, tail, n);
+    }
+
+    void insertBatch(size_t shardIdx, void* head, void* tail, size_t n) {
+        if (n == batchSize_) {
+            TransferShard& shard = shards_[shardIdx];
+            std::lock_guard<SpinLock> lock(shard.lock);
+            size_t used = shard.used.load(std::memory_order_relaxed);
+            if (used < kTransferSlots) {
+                shard.slots[used] = head;
+                shard.used.store(used + 1, std::memory_order_relaxed);
+                return;
+            }
         }
+        std::lock_guard<std::mutex> lock(globalMutex_);
+        setNext(tail, globalFreeList_);
+        globalFreeList_ = head;
+        globalFreeCount_ += n;
     }
 
-    void flushLocalToGlobal(std::vector<void*>& local) {
+    // 取出一批以 nullptr 结尾的块链表, 返回块数; 中心缓存为空时返回 0
+    size_t removeBatch(size_t shardIdx, void*& head) {
+        for (size_t i = 0; i < kTransferShards; i++) {
+            TransferShard& shard = shards_[(shardIdx + i) % kTransferShards];
+            if (shard.used.load(std::memory_order_relaxed) == 0) continue;
+            std::lock_guard<SpinLock> lock(shard.lock);
+            size_t used = shard.used.load(std::memory_order_relaxed);
+            if (used > 0) {
+                head = shard.slots[used - 1];
+                shard.used.store(used - 1, std::memory_order_relaxed);
+                return batchSize_;
+            }
+        }
+
         std::lock_guard<std::mutex> lock(globalMutex_);
-        size_t keep = localCacheLimit_;
-        while (local.size() > keep) {
-            globalFreeList_.push_back(local.back());
-            local.pop_back();
+        size_t n = std::min(batchSize_, globalFreeCount_);
+        if (n == 0) return 0;
+        head = globalFreeList_;
+        void* tail = head;
+        for (size_t i = 1; i < n; i++) tail = nextOf(tail);
+        globalFreeList_ = nextOf(tail);
+        globalFreeCount_ -= n;
+        setNext(tail, nullptr);
+        return n;
+    }
+
+    // ======================= 每 CPU 缓存 =======================
+
+    CpuCache& cpuCache() {
+        int cpu = currentCpu();
+        if (cpu < 0) [[unlikely]] cpu = std::max(sched_getcpu(), 0);   // 线程退出阶段 rseq 可能已注销
+        return cpuCaches_[static_cast<size_t>(cpu) % numCpus_];
+    }
+
+    size_t shardOf(const CpuCache& c) const {
+        return static_cast<size_t>(&c - cpuCaches_) % kTransferShards;
+    }
+
+    void* allocatePerCpu() {
+        CpuCache& c = cpuCache();
+        {
+            std::lock_guard<SpinLock> lock(c.lock);
+            c.allocs++;
+            if (void* p = c.head) [[likely]] {
+                c.head = nextOf(p);
+                if (--c.count < c.lowWater) c.lowWater = c.count;
+                return p;
+            }
+            c.misses++;
+        }
+        return refillCpuCache(c);
+    }
+
+    // 在锁外从中心缓存取一批, 留下第一个块, 其余并入 CPU 缓存
+    [[gnu::noinline]] void* refillCpuCache(CpuCache& c) {
+        void* head = nullptr;
+        size_t n = removeBatch(shardOf(c), head);
+        if (n == 0) n = allocateChunk(&orphan_, head);
+        if (void* rest = nextOf(head)) {
+            std::lock_guard<SpinLock> lock(c.lock);
+            // 等待期间其他线程可能已经补充过, 才需要找到这批的尾部
+            if (c.head) {
+                void* tail = rest;
+                while (nextOf(tail)) tail = nextOf(tail);
+                setNext(tail, c.head);
+            }
+            c.head = rest;
+            c.count += n - 1;
+        }
+        return head;
+    }
+
+    void deallocatePerCpu(void* p) {
+        CpuCache& c = cpuCache();
+        void* head = nullptr;
+        void* tail = nullptr;
+        size_t n = 0;
+        {
+            std::lock_guard<SpinLock> lock(c.lock);
+            setNext(p, c.head);
+            c.head = p;
+            c.count++;
+            c.frees++;
+            uint64_t epoch = scavengeEpoch_.load(std::memory_order_relaxed);
+            if (c.epoch != epoch) [[unlikely]] {
+                // 同 decay(): 交回上个周期从未用到的块的一半
+                c.epoch = epoch;
+                n = std::min(c.lowWater, c.count) / 2;
+                if (n > 0) head = detachLocked(c, n, tail);
+                c.lowWater = c.count;
+            } else if (c.count > localCacheLimit_ * 2) [[unlikely]] {
+                n = batchSize_;
+                head = detachLocked(c, n, tail);
+            }
+        }
+        if (n > 0) insertBatch(shardOf(c), head, tail, n);
+    }
+
+    template <typename T>
+    void allocateBatchPerCpu(T** out, size_t n) {
+        size_t i = 0;
+        {
+            CpuCache& c = cpuCache();
+            std::lock_guard<SpinLock> lock(c.lock);
+            for (; i < n && c.head; i++) {
+                out[i] = static_cast<T*>(c.head);
+                c.head = nextOf(c.head);
+                c.count--;
+            }
+            c.allocs += i;
+            if (c.count < c.lowWater) c.lowWater = c.count;
+        }
+        try {
+            for (; i < n; i++) out[i] = static_cast<T*>(allocatePerCpu());
+        } catch (...) {
+            deallocateBatchPerCpu(out, i);
+            throw;
         }
     }
 
+    template <typename T>
+    void deallocateBatchPerCpu(T* const* ptrs, size_t n) {
+        CpuCache& c = cpuCache();
+        {
+            std::lock_guard<SpinLock> lock(c.lock);
+            for (size_t i = 0; i < n; i++) {
+                if (!ptrs[i]) continue;
+                setNext(ptrs[i], c.head);
+                c.head = ptrs[i];
+                c.count++;
+                c.frees++;
+            }
+        }
+        for (;;) {
+            void* head = nullptr;
+            void* tail = nullptr;
+            {
+                std::lock_guard<SpinLock> lock(c.lock);
+                if (c.count <= localCacheLimit_ * 2) return;
+                head = detachLocked(c, batchSize_, tail);
+            }
+            insertBatch(shardOf(c), head, tail, batchSize_);
+        }
+    }
+
+    // 持有 c.lock 时从头部摘下 n 个块
+    static void* detachLocked(CpuCache& c, size_t n, void*& tail) {
+        void* head = c.head;
+        tail = head;
+        for (size_t i = 1; i < n; i++) tail = nextOf(tail);
+        c.head = nextOf(tail);
+        c.count -= n;
+        c.flushes++;
+        setNext(tail, nullptr);
+        return head;
+    }
+
+    // 线程的 thread_local 已析构(线程退出阶段)时, 逐块直接访问中心缓存;
+    // 此时切分出的 chunk 归 orphan_ 所有, orphan_ 永远处于非活跃状态
+    void* allocateSlow() {
+        slowAllocs_.fetch_add(1, std::memory_order_relaxed);
+        void* head = nullptr;
+        size_t n = removeBatch(0, head);
+        if (n == 0) n = allocateChunk(&orphan_, head);
+        void* rest = nextOf(head);
+        if (rest) {
+            void* tail = rest;
+            while (nextOf(tail)) tail = nextOf(tail);
+            insertBatch(0, rest, tail, n - 1);
+        }
+        return head;
+    }
+
+    void deallocateSlow(void* p) {
+        slowFrees_.fetch_add(1, std::memory_order_relaxed);
+        setNext(p, nullptr);
+        insertBatch(0, p, p, 1);
+    }
+
 private:
     const size_t blockSize_;
+    const size_t chunkAlign_;
     const size_t blocksPerChunk_;
     const size_t localCacheLimit_;
+    const size_t batchSize_;
+    const size_t headerSize_;
+    const uint8_t sizeClassTag_;
+    size_t id_ = 0;
 
-    std::vector<void*> globalFreeList_;
+    TransferShard shards_[kTransferShards];
+
+    // 中心缓存的溢出链表
+    alignas(64) void* globalFreeList_ = nullptr;
+    size_t globalFreeCount_ = 0;
     std::mutex globalMutex_;
 
-    std::vector<void*> chunks_;
+    alignas(64) ChunkHeader* chunkList_ = nullptr;
+    size_t numChunks_ = 0;
     std::mutex chunksMutex_;
+
+    ThreadCache* caches_ = nullptr;
+    size_t numCaches_ = 0;
+    std::mutex cachesMutex_;
+    ThreadCache orphan_;
+
+    CpuCache* cpuCaches_ = nullptr;
+    size_t numCpus_ = 0;
+
+    // 线程退出阶段绕过缓存的分配与释放
+    std::atomic<uint64_t> slowAllocs_{0};
+    std::atomic<uint64_t> slowFrees_{0};
+    static inline std::atomic<int> perCpuSetting_{-1};   // -1: 未设置, 取环境变量
+
+    static inline thread_local bool tlsDead_ = false;
+    static inline std::atomic<uint64_t> scavengeEpoch_{0};
 };
 
 // ==============================================================
 //                     GlobalPoolManager
-//          多尺寸池：8,16,24,...4096 字节 size-classes
+//     几何级数 size-classes: 128 字节以内步长 8, 之后每翻一倍分 8 档,
+//     内部碎片不超过 12.5%; size -> class 查表一次完成
 // ==============================================================
 
 static constexpr size_t ALIGN = 8;
 static constexpr size_t MAX_POOL_SIZE = 4096;
-static constexpr int NUM_CLASSES = MAX_POOL_SIZE / ALIGN;
 
 static inline size_t align_up(size_t n) {
     return (n + ALIGN - 1) & ~(ALIGN - 1);
 }
 
+struct SizeClassInfo {
+    size_t size;            // 块尺寸
+    size_t blocksPerChunk;  // 每个 chunk 的块数
+    size_t batch;           // 线程缓存上限 / 中心缓存每批的块数
+};
+
+namespace size_class_detail {
+
+    // 每个 chunk 的目标大小(含 chunk 头)
+    inline constexpr size_t kChunkBytes = 64 * 1024;
+    inline constexpr size_t kChunkHeader = 64;
+    inline constexpr size_t kBatchBytes = 16 * 1024;
+
+    constexpr size_t countClasses() {
+        size_t n = 0;
+        for (size_t sz = ALIGN; sz <= MAX_POOL_SIZE; ) {
+            n++;
+            sz += sz < 128 ? ALIGN : (size_t(1) << (std::bit_width(sz) - 1)) / 8;
+        }
+        return n;
+    }
+
+    inline constexpr size_t kNumClasses = countClasses();
+
+    constexpr std::array<SizeClassInfo, kNumClasses> makeClasses() {
+        std::array<SizeClassInfo, kNumClasses> classes{};
+        size_t i = 0;
+        for (size_t sz = ALIGN; sz <= MAX_POOL_SIZE; ) {
+            size_t batch = kBatchBytes / sz;
+            batch = batch < 2 ? 2 : (batch > 64 ? 64 : batch);
+            classes[i++] = SizeClassInfo{ sz, (kChunkBytes - kChunkHeader) / sz, batch };
+            sz += sz < 128 ? ALIGN : (size_t(1) << (std::bit_width(sz) - 1)) / 8;
+        }
+        return classes;
+    }
+
+    // 以 (size + 7) >> 3 为下标
+    constexpr std::array<uint8_t, MAX_POOL_SIZE / ALIGN + 1> makeIndex(const std::array<SizeClassInfo, kNumClasses>& classes) {
+        std::array<uint8_t, MAX_POOL_SIZE / ALIGN + 1> index{};
+        size_t cls = 0;
+        for (size_t i = 0; i < index.size(); i++) {
+            size_t sz = i * ALIGN;
+            while (classes[cls].size < sz) cls++;
+            index[i] = static_cast<uint8_t>(cls);
+        }
+        return index;
+    }
+
+    inline constexpr auto kClasses = makeClasses();
+    inline constexpr auto kClassIndex = makeIndex(kClasses);
+
+    // 缓存行对齐: 尺寸向上取整到 64 的倍数后落到的 size-class 也是 64 的倍数,
+    // chunk 头又恰好占一条 cache line, 所以这些块天然按 64 对齐, 不需要单独的池
+    constexpr bool cacheLineClassesAligned(const std::array<SizeClassInfo, kNumClasses>& classes,
+                                           const std::array<uint8_t, MAX_POOL_SIZE / ALIGN + 1>& index) {
+        for (size_t sz = 64; sz <= MAX_POOL_SIZE; sz += 64) {
+            if (classes[index[sz / ALIGN]].size % 64 != 0) return false;
+        }
+        return true;
+    }
+
+    // 页对齐 size-class(O_DIRECT 缓冲等): chunk 头占满一页, 块尺寸是页的整数倍
+    inline constexpr size_t kPageChunkBytes = 256 * 1024;
+    inline constexpr size_t kNumPageClasses = 4;
+    inline constexpr size_t kMaxPageClassSize = size_t(4096) << (kNumPageClasses - 1);
+
+    constexpr std::array<SizeClassInfo, kNumPageClasses> makePageClasses() {
+        std::array<SizeClassInfo, kNumPageClasses> classes{};
+        for (size_t i = 0; i < kNumPageClasses; i++) {
+            size_t sz = size_t(4096) << i;
+            size_t batch = kBatchBytes / sz;
+            classes[i] = SizeClassInfo{ sz, (kPageChunkBytes - 4096) / sz, batch < 2 ? 2 : batch };
+        }
+        return classes;
+    }
+
+    inline constexpr auto kPageClasses = makePageClasses();
+
+    static_assert(kNumClasses <= 256, "class index must fit in uint8_t");
+    static_assert(kClasses[kNumClasses - 1].size == MAX_POOL_SIZE);
+    static_assert(cacheLineClassesAligned(kClasses, kClassIndex));
+
+} // namespace size_class_detail
+
+static constexpr int NUM_CLASSES = static_cast<int>(size_class_detail::kNumClasses);
+// 页对齐的 class 编号接在普通 class 之后
+static constexpr int NUM_PAGE_CLASSES = static_cast<int>(size_class_detail::kNumPageClasses);
+static constexpr int NUM_POOLS = NUM_CLASSES + NUM_PAGE_CLASSES;
+static constexpr size_t CACHE_LINE_SIZE = 64;
+// 页映射用 uint8_t 记录 class + 1
+static_assert(NUM_POOLS < 256);
+
 static inline int size_to_class(size_t n) {
-    n = align_up(n);
     if (n > MAX_POOL_SIZE) return -1;
-    return (int)(n / ALIGN) - 1;
+    return size_class_detail::kClassIndex[(n + 7) >> 3];
+}
+
+// 能放下 n 字节的页对齐 class, 超过 kMaxPageClassSize 时返回 -1
+static inline int size_to_page_class(size_t n) {
+    if (n > size_class_detail::kMaxPageClassSize) return -1;
+    size_t pages = (n + kPageSize - 1) >> kPageShift;
+    return NUM_CLASSES + (pages <= 1 ? 0 : std::bit_width(pages - 1));
 }
 
+static inline size_t class_to_size(int cls) {
+    if (cls >= NUM_CLASSES) return size_class_detail::kPageClasses[cls - NUM_CLASSES].size;
+    return size_class_detail::kClasses[cls].size;
+}
+
+// 进程唯一, 通过 instance() 访问; 第一次调用前不分配任何内存,
+// 各 size-class 的池在该尺寸第一次被分配时才创建
+struct AllocatorStats {
+    PoolStats classes[NUM_POOLS];   // 下标即 size-class, 尚未创建的池只填写 blockSize
+    PageHeapStats pageHeap;
+};
+
 class GlobalPoolManager {
 public:
-    GlobalPoolManager() {
-        for (int i = 0; i < NUM_CLASSES; i++) {
-            pools_[i] = new ThreadSafeMemoryPool((i + 1) * ALIGN, 1024, 64);
-        }
+    // 故意不析构: 其他静态对象析构时仍可能归还内存
+    static GlobalPoolManager& instance() {
+        static GlobalPoolManager* manager = new (sysAlloc(sizeof(GlobalPoolManager))) GlobalPoolManager();
+        return *manager;
     }
 
-    ~GlobalPoolManager() {
-        for (int i = 0; i < NUM_CLASSES; i++) {
-            delete pools_[i];
-        }
-    }
+    GlobalPoolManager(const GlobalPoolManager&) = delete;
+    GlobalPoolManager& operator=(const GlobalPoolManager&) = delete;
 
     void* allocate(size_t size) {
+        if (HeapProfiler::shouldSample(size)) [[unlikely]] return allocateSampled(size);
         int cls = size_to_class(size);
-        if (cls < 0) return std::malloc(size);
-        return pools_[cls]->allocate();
+        if (cls < 0) return PageHeap::instance().allocate(size);
+        return pool(cls)->allocate();
     }
 
     void deallocate(void* p, size_t size) {
+        if (!p) return;
+        int cls = size_to_class(size);
+        // 采样到的小对象也来自 PageHeap, 页上没有 size-class 标记
+        if (cls < 0 || (HeapProfiler::hasLiveSamples() && PageHeap::instance().sizeClassOf(p) == 0)) {
+            deallocateLarge(p);
+            return;
+        }
+        // 能释放说明该尺寸分配过, 池一定已经存在
+        pools_[cls].load(std::memory_order_acquire)->deallocate(p);
+    }
+
+    // 批量分配 n 个同尺寸的块: size-class 与池只查找一次
+    template <typename T>
+    void allocateBatch(size_t size, T** out, size_t n) {
         int cls = size_to_class(size);
-        if (cls < 0) {
-            std::free(p);
+        if (cls >= 0) {
+            pool(cls)->allocateBatch(out, n);
             return;
         }
-        pools_[cls]->deallocate(p);
+        size_t i = 0;
+        try {
+            for (; i < n; i++) out[i] = static_cast<T*>(PageHeap::instance().allocate(size));
+        } catch (...) {
+            deallocateBatch(size, out, i);
+            throw;
+        }
+    }
+
+    template <typename T>
+    void deallocateBatch(size_t size, T* const* ptrs, size_t n) {
+        int cls = size_to_class(size);
+        if (cls >= 0 && !HeapProfiler::hasLiveSamples()) {
+            pools_[cls].load(std::memory_order_acquire)->deallocateBatch(ptrs, n);
+            return;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (ptrs[i]) deallocate(ptrs[i], size);
+        }
+    }
+
+    // 调整 p 的大小, 保留前 min(oldSize, newSize) 字节: 新尺寸仍落在同一 size-class 时原地返回;
+    // 大对象由 PageHeap 原地伸缩(并入相邻空闲 Span, 或 mremap); 其余情况分配-复制-释放
+    void* reallocate(void* p, size_t oldSize, size_t newSize) {
+        if (!p) return allocate(newSize);
+        int oldCls = size_to_class(oldSize);
+        int newCls = size_to_class(newSize);
+        bool sampling = HeapProfiler::hasLiveSamples();
+        bool inPool = oldCls >= 0 && (!sampling || PageHeap::instance().sizeClassOf(p) != 0);
+        if (inPool && newCls == oldCls) return p;
+        // 采样对象的地址登记在 HeapProfiler 中, mremap 搬移后会对不上, 有存活采样时不走这条路
+        if (!inPool && newCls < 0 && !sampling) {
+            if (void* q = PageHeap::instance().reallocate(p, newSize)) return q;
+        }
+        void* q = allocate(newSize);
+        std::memcpy(q, p, std::min(oldSize, newSize));
+        deallocate(p, oldSize);
+        return q;
+    }
+
+    // 不带旧尺寸的版本(供 realloc): 由页映射得到块的可用大小, 缩小不超过一半时原地保留
+    void* reallocate(void* p, size_t newSize) {
+        if (!p) return allocate(newSize);
+        size_t usable;
+        if (uint8_t tag = PageHeap::instance().sizeClassOf(p)) {
+            usable = class_to_size(tag - 1);
+            if (newSize <= usable && newSize >= usable / 2) return p;
+        } else {
+            usable = PageHeap::instance().spanOf(p)->bytes();
+            if (newSize > MAX_POOL_SIZE && !HeapProfiler::hasLiveSamples()) {
+                if (void* q = PageHeap::instance().reallocate(p, newSize)) return q;
+            }
+        }
+        void* q = allocate(newSize);
+        std::memcpy(q, p, std::min(usable, newSize));
+        deallocate(p);
+        return q;
+    }
+
+    // align 为 2 的幂: 不超过 8 走普通 class; 不超过 64 取整到 align 的倍数后仍走普通 class;
+    // 不超过一页走页对齐 class; 更大的直接向 PageHeap 要对齐的 Span
+    void* allocateAligned(size_t size, size_t align) {
+        if (align <= ALIGN) return allocate(size);
+        if (align <= CACHE_LINE_SIZE) return allocate(alignedSize(size, align));
+        if (align <= kPageSize) {
+            int cls = size_to_page_class(alignedSize(size, align));
+            if (cls < 0) return PageHeap::instance().allocate(size);
+            return pool(cls)->allocate();
+        }
+        return PageHeap::instance().allocateAligned(size, align);
+    }
+
+    void deallocateAligned(void* p, size_t size, size_t align) {
+        if (!p) return;
+        if (align <= ALIGN) {
+            deallocate(p, size);
+        } else if (align <= CACHE_LINE_SIZE) {
+            deallocate(p, alignedSize(size, align));
+        } else if (int cls = size_to_page_class(alignedSize(size, align)); align <= kPageSize && cls >= 0) {
+            pools_[cls].load(std::memory_order_acquire)->deallocate(p);
+        } else {
+            PageHeap::instance().deallocate(p);
+        }
+    }
+
+    // 不带尺寸的释放: 由 PageHeap 的页 -> size-class 映射找到所属的池
+    void deallocate(void* p) {
+        if (!p) return;
+        uint8_t tag = PageHeap::instance().sizeClassOf(p);
+        if (tag == 0) {
+            deallocateLarge(p);
+            return;
+        }
+        pools_[tag - 1].load(std::memory_order_acquire)->deallocate(p);
+    }
+
+    // p 实际可用的字节数: 所在 size-class 的块大小, 或大对象所在 Span 的大小
+    size_t usableSize(const void* p) const {
+        uint8_t tag = PageHeap::instance().sizeClassOf(p);
+        if (tag == 0) return PageHeap::instance().spanOf(p)->bytes();
+        return class_to_size(tag - 1);
+    }
+
+    // 立即回收所有完全空闲的 chunk, 并把 PageHeap 中的空闲页全部归还给操作系统
+    size_t trim() {
+        ThreadSafeMemoryPool::advanceScavengeEpoch();
+        trimPools();
+        return PageHeap::instance().releaseFreeMemory();
+    }
+
+    // 后台扫描线程: 每个 interval 推进一次纪元让线程缓存衰减、回收空闲 chunk,
+    // 并最多向操作系统归还 releaseBytesPerTick 字节
+    void startScavenger(std::chrono::milliseconds interval = std::chrono::milliseconds(1000),
+                        size_t releaseBytesPerTick = 16 * 1024 * 1024) {
+        std::lock_guard<std::mutex> lock(scavengerMutex_);
+        if (scavenger_.joinable()) return;
+        scavengerStop_ = false;
+        scavenger_ = std::thread([this, interval, releaseBytesPerTick]() {
+            std::unique_lock<std::mutex> lock(scavengerMutex_);
+            while (!scavengerCv_.wait_for(lock, interval, [this]() { return scavengerStop_; })) {
+                lock.unlock();
+                ThreadSafeMemoryPool::advanceScavengeEpoch();
+                trimPools();
+                PageHeap::instance().releaseFreeMemory(releaseBytesPerTick);
+                lock.lock();
+            }
+        });
+    }
+
+    void stopScavenger() {
+        std::thread t;
+        {
+            std::lock_guard<std::mutex> lock(scavengerMutex_);
+            scavengerStop_ = true;
+            t = std::move(scavenger_);
+        }
+        scavengerCv_.notify_all();
+        if (t.joinable()) t.join();
+    }
+
+    AllocatorStats stats() {
+        AllocatorStats st;
+        for (int i = 0; i < NUM_POOLS; i++) {
+            if (ThreadSafeMemoryPool* p = pools_[i].load(std::memory_order_acquire)) {
+                st.classes[i] = p->stats();
+            } else {
+                st.classes[i].blockSize = class_to_size(i);
+            }
+        }
+        st.pageHeap = PageHeap::instance().stats();
+        return st;
+    }
+
+    // 每个用到过的 size-class 一行, 最后是 PageHeap 的汇总
+    void dumpStats(std::ostream& os) {
+        AllocatorStats st = stats();
+        char line[256];
+        std::snprintf(line, sizeof(line), "%6s %12s %12s %7s %9s %9s %9s %6s %11s %11s %6s %8s %8s %8s\n",
+                      "class", "allocs", "frees", "hit%", "refills", "flushes", "remote", "chunks",
+                      "in_use", "reserved", "caches", "cached", "max", "central");
+        os << line;
+        PoolStats total;
+        for (const PoolStats& c : st.classes) {
+            if (c.allocs == 0 && c.chunks == 0) continue;
+            std::snprintf(line, sizeof(line),
+                          "%6zu %12llu %12llu %6.1f%% %9llu %9llu %9llu %6zu %11zu %11zu %6zu %8zu %8zu %8zu\n",
+                          c.blockSize, (unsigned long long)c.allocs, (unsigned long long)c.frees, c.hitRate() * 100,
+                          (unsigned long long)c.centralRefills, (unsigned long long)c.centralFlushes,
+                          (unsigned long long)c.remoteFrees, c.chunks, c.bytesInUse, c.bytesReserved,
+                          c.caches, c.cachedBlocks, c.maxCachedBlocks, c.centralBlocks);
+            os << line;
+            total.allocs += c.allocs;
+            total.frees += c.frees;
+            total.cacheMisses += c.cacheMisses;
+            total.bytesInUse += c.bytesInUse;
+            total.bytesReserved += c.bytesReserved;
+        }
+        std::snprintf(line, sizeof(line),
+                      "total: allocs %llu, frees %llu, hit %.1f%%, in use %zu, reserved %zu\n"
+                      "page heap: regions %zu, mapped %zu, free %zu (%zu spans), released %zu\n",
+                      (unsigned long long)total.allocs, (unsigned long long)total.frees, total.hitRate() * 100,
+                      total.bytesInUse, total.bytesReserved,
+                      st.pageHeap.regionBytes, st.pageHeap.mappedBytes, st.pageHeap.freeBytes,
+                      st.pageHeap.freeSpans, st.pageHeap.releasedBytes);
+        os << line;
+    }
+
+    // 堆采样: 平均每分配 bytes 字节记录一次调用栈, 0 关闭; 默认取环境变量 HSPD_HEAP_SAMPLE
+    void setSampleInterval(size_t bytes) {
+        HeapProfiler::setSampleInterval(bytes);
+    }
+
+    // 以 pprof heap_v2 文本格式输出采样到的存活与累计分配
+    void writeHeapProfile(std::ostream& os) {
+        HeapProfiler::instance().writeProfile(os);
     }
 
 private:
-    ThreadSafeMemoryPool* pools_[NUM_CLASSES];
+    GlobalPoolManager() = default;
+
+    // 对齐分配按此尺寸选择 size-class: 至少 align 字节并取整到 align 的倍数,
+    // 0 字节的请求也落在对齐的 class 上
+    static size_t alignedSize(size_t size, size_t align) {
+        return (std::max(size, align) + align - 1) & ~(align - 1);
+    }
+
+    // 采样到的对象单独占用 PageHeap 的 Span, 释放时经由 deallocateLarge 识别
+    [[gnu::noinline]] void* allocateSampled(size_t size) {
+        HeapProfiler& profiler = HeapProfiler::instance();
+        if (!profiler.beginSample()) {
+            int cls = size_to_class(size);
+            if (cls < 0) return PageHeap::instance().allocate(size);
+            return pool(cls)->allocate();
+        }
+        void* p = nullptr;
+        try {
+            p = PageHeap::instance().allocate(std::max<size_t>(size, 1));
+        } catch (...) {
+            profiler.endSample(nullptr, size);
+            throw;
+        }
+        profiler.endSample(p, size);
+        return p;
+    }
+
+    void deallocateLarge(void* p) {
+        if (HeapProfiler::hasLiveSamples()) [[unlikely]] HeapProfiler::instance().recordFree(p);
+        PageHeap::instance().deallocate(p);
+    }
+
+    ThreadSafeMemoryPool* pool(int cls) {
+        ThreadSafeMemoryPool* p = pools_[cls].load(std::memory_order_acquire);
+        if (p) [[likely]] return p;
+        return createPool(cls);
+    }
+
+    [[gnu::noinline]] ThreadSafeMemoryPool* createPool(int cls) {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        ThreadSafeMemoryPool* p = pools_[cls].load(std::memory_order_relaxed);
+        if (p) return p;
+        bool pageAligned = cls >= NUM_CLASSES;
+        const SizeClassInfo& info = pageAligned ? size_class_detail::kPageClasses[cls - NUM_CLASSES]
+                                                : size_class_detail::kClasses[cls];
+        p = new (sysAlloc(sizeof(ThreadSafeMemoryPool)))
+            ThreadSafeMemoryPool(info.size, info.blocksPerChunk, info.batch, static_cast<uint8_t>(cls + 1),
+                                 pageAligned ? kPageSize : ALIGN);
+        pools_[cls].store(p, std::memory_order_release);
+        return p;
+    }
+
+    void trimPools() {
+        for (int i = 0; i < NUM_POOLS; i++) {
+            if (ThreadSafeMemoryPool* p = pools_[i].load(std::memory_order_acquire)) {
+                p->trim();
+            }
+        }
+    }
+
+    std::atomic<ThreadSafeMemoryPool*> pools_[NUM_POOLS] = {};
+    std::mutex poolsMutex_;
+
+    std::thread scavenger_;
+    std::mutex scavengerMutex_;
+    std::condition_variable scavengerCv_;
+    bool scavengerStop_ = false;
 };
 
-static GlobalPoolManager gMemoryPool;
 
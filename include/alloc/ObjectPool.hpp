@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include "MemoryPool.hpp"
+#include "MemoryBudget.hpp"
+#include "PoolAllocator.hpp"
+
+namespace hspd {
+
+// ==============================================================
+//                          ObjectPool<T>
+//      类型化的对象池: 存储来自一个专用的 ThreadSafeMemoryPool,
+//      acquire() 返回带归还删除器的 unique_ptr。
+//      T 提供 reset() 且 maxIdle > 0 时, 归还的对象调用 reset() 后保持构造状态缓存,
+//      下次 acquire() 直接复用(带参数时调用 reset(args...) 重新初始化),
+//      对象内部已有的容器容量也一并保留。对象池必须比它发出的对象活得久。
+//      缓存的空闲对象在内存压力下释放: Moderate 时减半, Critical 时清空
+// ==============================================================
+
+template <typename T>
+class ObjectPool {
+public:
+    struct Deleter {
+        ObjectPool* pool = nullptr;
+        void operator()(T* p) const noexcept { pool->release(p); }
+    };
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+    explicit ObjectPool(size_t maxIdle = 0)
+        : pool_(blockSizeFor(), blocksPerChunkFor(), batchFor(), 0, alignof(T)),
+          maxIdle_(maxIdle)
+    {
+        static_assert(alignof(T) <= kPageSize, "ObjectPool blocks are aligned to at most a page");
+        idle_.reserve(maxIdle_);
+        if (maxIdle_ > 0) {
+            budgetCallback_ = MemoryBudget::instance().addCallback([this](MemoryPressure level) {
+                if (level == MemoryPressure::Critical) shrink(0);
+                else if (level == MemoryPressure::Moderate) shrink(idleCount() / 2);
+            });
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() {
+        if (budgetCallback_) MemoryBudget::instance().removeCallback(budgetCallback_);
+        for (T* p : idle_) destroy(p);
+    }
+
+    template <typename... Args>
+    Ptr acquire(Args&&... args) {
+        if constexpr (sizeof...(Args) == 0 || requires(T& t, Args&&... a) { t.reset(std::forward<Args>(a)...); }) {
+            if (T* p = popIdle()) {
+                if constexpr (sizeof...(Args) > 0) {
+                    try {
+                        p->reset(std::forward<Args>(args)...);
+                    } catch (...) {
+                        destroy(p);
+                        throw;
+                    }
+                }
+                return Ptr(p, Deleter{ this });
+            }
+        }
+        void* mem = pool_.allocate();
+        try {
+            return Ptr(new (mem) T(std::forward<Args>(args)...), Deleter{ this });
+        } catch (...) {
+            pool_.deallocate(mem);
+            throw;
+        }
+    }
+
+    void release(T* p) noexcept {
+        if constexpr (requires(T& t) { t.reset(); }) {
+            if (maxIdle_ > 0) {
+                // reset() 可能抛出(例如 Socket 从 epoll 摘除时), 此时不缓存, 直接销毁
+                try {
+                    p->reset();
+                } catch (...) {
+                    destroy(p);
+                    return;
+                }
+                if (pushIdle(p)) return;
+            }
+        }
+        destroy(p);
+    }
+
+    // 销毁空闲对象直到只剩 keep 个
+    void shrink(size_t keep = 0) {
+        for (;;) {
+            T* p;
+            {
+                std::lock_guard<SpinLock> lock(idleLock_);
+                if (idle_.size() <= keep) return;
+                p = idle_.back();
+                idle_.pop_back();
+            }
+            destroy(p);
+        }
+    }
+
+    size_t idleCount() const {
+        std::lock_guard<SpinLock> lock(idleLock_);
+        return idle_.size();
+    }
+
+private:
+    static constexpr size_t blockSizeFor() {
+        return (sizeof(T) + alignof(T) - 1) & ~(alignof(T) - 1);
+    }
+
+    static constexpr size_t blocksPerChunkFor() {
+        size_t n = (size_class_detail::kChunkBytes - size_class_detail::kChunkHeader) / blockSizeFor();
+        return n > 0 ? n : 1;
+    }
+
+    static constexpr size_t batchFor() {
+        size_t n = size_class_detail::kBatchBytes / blockSizeFor();
+        return n < 2 ? 2 : (n > 64 ? 64 : n);
+    }
+
+    T* popIdle() {
+        std::lock_guard<SpinLock> lock(idleLock_);
+        if (idle_.empty()) return nullptr;
+        T* p = idle_.back();
+        idle_.pop_back();
+        return p;
+    }
+
+    bool pushIdle(T* p) noexcept {
+        std::lock_guard<SpinLock> lock(idleLock_);
+        if (idle_.size() >= maxIdle_) return false;
+        idle_.push_back(p);     // 容量已预留, 不会分配
+        return true;
+    }
+
+    void destroy(T* p) noexcept {
+        p->~T();
+        pool_.deallocate(p);
+    }
+
+    ThreadSafeMemoryPool pool_;
+    const size_t maxIdle_;
+    mutable SpinLock idleLock_;
+    std::vector<T*, PoolAllocator<T*>> idle_;
+    size_t budgetCallback_ = 0;
+};
+
+} // namespace hspd
@@ -0,0 +1,593 @@
+#pragma once
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <type_traits>
+#include <sys/mman.h>
+
+// ==============================================================
+//                         PageHeap
+//     以页(4 KiB)为粒度的大对象分配器, 服务 4 KiB ~ 1 MiB 的请求
+// ==============================================================
+//
+// 内存从 mmap 的大区域中按 Span(连续页)切分, 空闲 Span 按页数挂在
+// kMaxSpanPages 条链表上, 分配时从恰好的页数向上找第一条非空链表即为
+// best-fit; 释放时通过 PageMap 在 O(1) 内找到 Span 以及左右相邻的 Span
+// 并合并。超过 1 MiB 的请求直接单独 mmap。所有元数据都来自 mmap,
+// 不经过 malloc。空闲 Span 可以通过 releaseFreeMemory() 以 MADV_DONTNEED
+// 归还给操作系统, 地址空间保留, 下次使用时由内核按需补零页。
+//
+// 大页: setHugePageMode() 或环境变量 HSPD_HUGEPAGES=advise|hugetlb 让之后的
+// 堆区域按 2 MiB 对齐并 madvise(MADV_HUGEPAGE), 或直接以 MAP_HUGETLB 映射
+// (预留的大页不足时退回普通映射)。hugetlb 区域的物理页不能按 4 KiB 归还,
+// releaseFreeMemory() 会跳过它们。
+
+static constexpr size_t kPageShift = 12;
+static constexpr size_t kPageSize = size_t(1) << kPageShift;
+static constexpr size_t kMaxSpanPages = 256;    // 1 MiB
+static constexpr size_t kHugePageSize = size_t(2) << 20;
+
+inline void* sysAlloc(size_t bytes) {
+    void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    return p;
+}
+
+inline void sysFree(void* p, size_t bytes) {
+    ::munmap(p, bytes);
+}
+
+// ==============================================================
+//                     MetadataAllocator
+//        从 mmap 的 slab 中切分固定大小的元数据对象, 调用方负责加锁
+// ==============================================================
+
+template <typename T>
+class MetadataAllocator {
+public:
+    T* allocate() {
+        if (freeList_) {
+            FreeNode* n = freeList_;
+            freeList_ = n->next;
+            return reinterpret_cast<T*>(n);
+        }
+        if (remaining_ < sizeof(Slot)) {
+            cursor_ = static_cast<char*>(sysAlloc(kSlabBytes));
+            remaining_ = kSlabBytes;
+        }
+        T* p = reinterpret_cast<T*>(cursor_);
+        cursor_ += sizeof(Slot);
+        remaining_ -= sizeof(Slot);
+        return p;
+    }
+
+    void deallocate(T* p) {
+        FreeNode* n = reinterpret_cast<FreeNode*>(p);
+        n->next = freeList_;
+        freeList_ = n;
+    }
+
+private:
+    struct FreeNode { FreeNode* next; };
+    union Slot { alignas(T) char obj[sizeof(T)]; FreeNode node; };
+
+    static constexpr size_t kSlabBytes = 64 * 1024;
+
+    FreeNode* freeList_ = nullptr;
+    char* cursor_ = nullptr;
+    size_t remaining_ = 0;
+};
+
+// ==============================================================
+//                         SysArray
+//      直接从 mmap 分配、按需倍增的数组, 新元素为零值; 调用方负责加锁
+// ==============================================================
+
+template <typename T>
+class SysArray {
+    static_assert(std::is_trivially_copyable_v<T>);
+public:
+    SysArray() = default;
+    SysArray(const SysArray&) = delete;
+    SysArray& operator=(const SysArray&) = delete;
+
+    ~SysArray() {
+        if (data_) sysFree(data_, cap_ * sizeof(T));
+    }
+
+    size_t size() const { return cap_; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    void ensure(size_t n) {
+        if (n <= cap_) return;
+        size_t cap = cap_ ? cap_ * 2 : kPageSize / sizeof(T);
+        while (cap < n) cap *= 2;
+        T* data = static_cast<T*>(sysAlloc(cap * sizeof(T)));
+        if (data_) {
+            std::memcpy(data, data_, cap_ * sizeof(T));
+            sysFree(data_, cap_ * sizeof(T));
+        }
+        data_ = data;
+        cap_ = cap;
+    }
+
+private:
+    T* data_ = nullptr;
+    size_t cap_ = 0;
+};
+
+// ==============================================================
+//                          PageMap
+//     三层基数树: 页号(48 位地址 - 12 位页内偏移 = 36 位) -> 值
+//     读无锁, 写由调用方串行化; 节点按需 mmap, 从不释放; 未登记的页读出 T{}
+// ==============================================================
+
+template <typename T>
+class PageMap {
+public:
+    static constexpr size_t kBits = 48 - kPageShift;
+    static constexpr size_t kLeafBits = kBits / 3;
+    static constexpr size_t kMidBits = kBits / 3;
+    static constexpr size_t kRootBits = kBits - kLeafBits - kMidBits;
+
+    T get(uintptr_t page) const {
+        if (page >> kBits) return T{};
+        Mid* mid = root_[page >> (kLeafBits + kMidBits)].load(std::memory_order_acquire);
+        if (!mid) return T{};
+        Leaf* leaf = mid->leaves[(page >> kLeafBits) & (kMidLen - 1)].load(std::memory_order_acquire);
+        if (!leaf) return T{};
+        return leaf->values[page & (kLeafLen - 1)].load(std::memory_order_acquire);
+    }
+
+    void set(uintptr_t page, T v) {
+        assert(!(page >> kBits));
+        auto& midSlot = root_[page >> (kLeafBits + kMidBits)];
+        Mid* mid = midSlot.load(std::memory_order_relaxed);
+        if (!mid) {
+            mid = new (sysAlloc(sizeof(Mid))) Mid();
+            midSlot.store(mid, std::memory_order_release);
+        }
+        auto& leafSlot = mid->leaves[(page >> kLeafBits) & (kMidLen - 1)];
+        Leaf* leaf = leafSlot.load(std::memory_order_relaxed);
+        if (!leaf) {
+            leaf = new (sysAlloc(sizeof(Leaf))) Leaf();
+            leafSlot.store(leaf, std::memory_order_release);
+        }
+        leaf->values[page & (kLeafLen - 1)].store(v, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t kRootLen = size_t(1) << kRootBits;
+    static constexpr size_t kMidLen = size_t(1) << kMidBits;
+    static constexpr size_t kLeafLen = size_t(1) << kLeafBits;
+
+    struct Leaf { std::atomic<T> values[kLeafLen]; };
+    struct Mid { std::atomic<Leaf*> leaves[kMidLen]; };
+
+    std::atomic<Mid*> root_[kRootLen] = {};
+};
+
+// ==============================================================
+//                            Span
+// ==============================================================
+
+struct Span {
+    enum class State : uint8_t {
+        InUse,      // 已分配, 位于堆区域内
+        Free,       // 空闲, 挂在某条空闲链表上
+        Mapped,     // 超过 kMaxSpanPages, 单独 mmap
+    };
+
+    uintptr_t start = 0;    // 起始页号
+    size_t npages = 0;
+    State state = State::InUse;
+    bool released = false;  // 空闲且物理页已归还给操作系统
+    bool hugetlb = false;   // 位于 MAP_HUGETLB 区域, 不与普通页合并, 也不归还
+    uint8_t sizeClass = 0;  // 非 0 表示内存池的 chunk, 每一页都登记在 PageHeap 的 size-class 映射中
+    Span* prev = nullptr;
+    Span* next = nullptr;
+
+    void* address() const { return reinterpret_cast<void*>(start << kPageShift); }
+    size_t bytes() const { return npages << kPageShift; }
+};
+
+struct PageHeapStats {
+    size_t regionBytes = 0;     // 堆区域向系统申请的总字节数
+    size_t mappedBytes = 0;     // 超过 1 MiB、单独 mmap 的大对象
+    size_t freeBytes = 0;       // 堆区域中的空闲 Span(含已归还的)
+    size_t releasedBytes = 0;   // 其中物理页已归还给操作系统的部分
+    size_t freeSpans = 0;
+};
+
+enum class HugePageMode : uint8_t {
+    None,       // 普通 4 KiB 页
+    Advise,     // 区域按 2 MiB 对齐并 madvise(MADV_HUGEPAGE), 由透明大页合并
+    HugeTLB,    // MAP_HUGETLB 映射, 需要系统预留大页
+};
+
+class PageHeap {
+public:
+    // 进程唯一, 故意不析构
+    static PageHeap& instance() {
+        static PageHeap* heap = new (sysAlloc(sizeof(PageHeap))) PageHeap();
+        return *heap;
+    }
+
+    void* allocate(size_t bytes) {
+        if (bytes > kMaxAllocBytes) throw std::bad_alloc();
+        size_t npages = (bytes + kPageSize - 1) >> kPageShift;
+        if (npages == 0) npages = 1;
+
+        void* p;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            p = npages > kMaxSpanPages ? allocateMapped(npages)->address() : carve(npages, 1)->address();
+        }
+        checkWatermark();
+        return p;
+    }
+
+    // 按 align(页大小的整数倍, 2 的幂) 对齐的 Span, 供内存池切 chunk 使用;
+    // sizeClass 非 0 时把每一页登记为该 size-class, 释放 Span 时自动清除
+    void* allocateAligned(size_t bytes, size_t align, uint8_t sizeClass = 0) {
+        assert(align >= kPageSize && (align & (align - 1)) == 0);
+        if (bytes > kMaxAllocBytes) throw std::bad_alloc();
+        size_t npages = (bytes + kPageSize - 1) >> kPageShift;
+        if (npages == 0) npages = 1;
+
+        void* p;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Span* span = carve(npages, align >> kPageShift);
+            if (sizeClass) setSizeClass(span, sizeClass);
+            p = span->address();
+        }
+        checkWatermark();
+        return p;
+    }
+
+    void deallocate(void* p) {
+        uintptr_t page = reinterpret_cast<uintptr_t>(p) >> kPageShift;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Span* span = pageMap_.get(page);
+        assert(span && span->start == page && span->state != Span::State::Free);
+        if (span->sizeClass) setSizeClass(span, 0);
+        usedBytes_.fetch_sub(span->bytes(), std::memory_order_relaxed);
+
+        if (span->state == Span::State::Mapped) {
+            mappedBytes_ -= span->bytes();
+            setBoundaries(span, nullptr);
+            sysFree(span->address(), span->bytes());
+            spans_.deallocate(span);
+            return;
+        }
+
+        span->state = Span::State::Free;
+        span->released = false;
+        span = coalesce(span);
+        link(span);
+    }
+
+    // 原地调整 p 所在 Span 的大小: 堆内的 Span 缩小时切掉尾部, 增长时并入右侧相邻的空闲 Span;
+    // 单独映射的 Span 用 mremap, 可能搬移。返回新地址, 做不到时返回 nullptr, 由调用方分配-复制-释放
+    void* reallocate(void* p, size_t bytes) {
+        if (bytes > kMaxAllocBytes) return nullptr;
+        size_t npages = (bytes + kPageSize - 1) >> kPageShift;
+        if (npages == 0) npages = 1;
+        void* q;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            q = resizeLocked(p, npages);
+        }
+        checkWatermark();
+        return q;
+    }
+
+    // 由 PageHeap 分配出去的字节数(在用的 Span 与单独映射的大对象), 无锁
+    size_t usedBytes() const { return usedBytes_.load(std::memory_order_relaxed); }
+
+    // usedBytes() 达到 bytes 后, 下一次分配在释放锁之后调用 hook(usedBytes());
+    // hook 负责重新设置水位, 否则之后每次分配都会调用它
+    void setWatermark(size_t bytes, void (*hook)(size_t)) {
+        watermarkHook_.store(hook, std::memory_order_relaxed);
+        watermark_.store(bytes, std::memory_order_release);
+    }
+
+    // 把空闲 Span 的物理页归还给操作系统, 从大 Span 开始, 至多 maxBytes; 返回实际归还的字节数
+    size_t releaseFreeMemory(size_t maxBytes = SIZE_MAX) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t released = 0;
+        auto releaseList = [&](Span& head) {
+            for (Span* s = head.next; s != &head && released < maxBytes; s = s->next) {
+                if (s->released || s->hugetlb) continue;
+                ::madvise(s->address(), s->bytes(), MADV_DONTNEED);
+                s->released = true;
+                released += s->bytes();
+            }
+        };
+        releaseList(large_);
+        for (size_t n = kMaxSpanPages; n > 0 && released < maxBytes; n--) {
+            releaseList(freeLists_[n]);
+        }
+        return released;
+    }
+
+    // 遍历空闲链表统计, 持锁时间与空闲 Span 数成正比
+    PageHeapStats stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        PageHeapStats st;
+        st.regionBytes = regionBytes_;
+        st.mappedBytes = mappedBytes_;
+        auto countList = [&](Span& head) {
+            for (Span* s = head.next; s != &head; s = s->next) {
+                st.freeBytes += s->bytes();
+                if (s->released) st.releasedBytes += s->bytes();
+                st.freeSpans++;
+            }
+        };
+        countList(large_);
+        for (size_t n = 1; n <= kMaxSpanPages; n++) countList(freeLists_[n]);
+        return st;
+    }
+
+    // 只影响之后向系统申请的区域
+    void setHugePageMode(HugePageMode mode) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hugePageMode_ = mode;
+    }
+
+    // 供释放路径无锁查询; 仅 Span 的首尾页有效
+    Span* spanOf(const void* p) const {
+        return pageMap_.get(reinterpret_cast<uintptr_t>(p) >> kPageShift);
+    }
+
+    // p 所在页登记的 size-class, 0 表示不属于内存池; 无锁
+    uint8_t sizeClassOf(const void* p) const {
+        return sizeClasses_.get(reinterpret_cast<uintptr_t>(p) >> kPageShift);
+    }
+
+private:
+    // 单次分配的上限, 超过 48 位地址空间的一半不可能满足
+    static constexpr size_t kMaxAllocBytes = size_t(1) << 47;
+
+    // 每次向系统申请的最小页数(8 MiB)
+    static constexpr size_t kGrowPages = 2048;
+
+    PageHeap() {
+        for (size_t i = 0; i <= kMaxSpanPages; i++) {
+            freeLists_[i].prev = freeLists_[i].next = &freeLists_[i];
+        }
+        large_.prev = large_.next = &large_;
+        if (const char* env = std::getenv("HSPD_HUGEPAGES")) {
+            if (std::strcmp(env, "advise") == 0) hugePageMode_ = HugePageMode::Advise;
+            else if (std::strcmp(env, "hugetlb") == 0) hugePageMode_ = HugePageMode::HugeTLB;
+        }
+    }
+
+    // 空闲链表: 1..kMaxSpanPages 按精确页数, 更大的挂在 large_ 上
+    Span& listFor(size_t npages) {
+        return npages <= kMaxSpanPages ? freeLists_[npages] : large_;
+    }
+
+    Span* findBestFit(size_t npages) {
+        for (size_t n = npages; n <= kMaxSpanPages; n++) {
+            if (freeLists_[n].next != &freeLists_[n]) return freeLists_[n].next;
+        }
+        Span* best = nullptr;
+        for (Span* s = large_.next; s != &large_; s = s->next) {
+            if (s->npages >= npages && (!best || s->npages < best->npages)) best = s;
+        }
+        return best;
+    }
+
+    void link(Span* span) {
+        Span& head = listFor(span->npages);
+        span->prev = &head;
+        span->next = head.next;
+        head.next->prev = span;
+        head.next = span;
+    }
+
+    static void unlink(Span* span) {
+        span->prev->next = span->next;
+        span->next->prev = span->prev;
+        span->prev = span->next = nullptr;
+    }
+
+    // 首尾页都登记在 PageMap 中, 合并时据此找到相邻 Span
+    void setBoundaries(Span* span, Span* value) {
+        pageMap_.set(span->start, value);
+        pageMap_.set(span->start + span->npages - 1, value);
+    }
+
+    void setSizeClass(Span* span, uint8_t sizeClass) {
+        span->sizeClass = sizeClass;
+        for (size_t i = 0; i < span->npages; i++) {
+            sizeClasses_.set(span->start + i, sizeClass);
+        }
+    }
+
+    Span* newSpan(uintptr_t start, size_t npages, Span::State state) {
+        Span* span = new (spans_.allocate()) Span();
+        span->start = start;
+        span->npages = npages;
+        span->state = state;
+        setBoundaries(span, span);
+        return span;
+    }
+
+    // 取出 npages 页且起始页号按 alignPages 对齐的 Span, 多余的头尾放回空闲链表
+    Span* carve(size_t npages, size_t alignPages) {
+        size_t need = npages + alignPages - 1;
+        Span* span = findBestFit(need);
+        if (!span) {
+            grow(need);
+            span = findBestFit(need);
+        }
+        unlink(span);
+
+        size_t skip = (alignPages - span->start % alignPages) % alignPages;
+        if (skip > 0) {
+            Span* head = span;
+            span = split(head, skip);
+            link(head);
+        }
+        if (span->npages > npages) {
+            link(split(span, npages));
+        }
+        span->state = Span::State::InUse;
+        usedBytes_.fetch_add(span->bytes(), std::memory_order_relaxed);
+        return span;
+    }
+
+    // 保留前 npages 页, 返回剩余部分组成的新 Span(状态与原 Span 相同, 未挂链)
+    Span* split(Span* span, size_t npages) {
+        Span* rest = newSpan(span->start + npages, span->npages - npages, span->state);
+        rest->released = span->released;
+        rest->hugetlb = span->hugetlb;
+        span->npages = npages;
+        setBoundaries(span, span);
+        return rest;
+    }
+
+    Span* coalesce(Span* span) {
+        if (Span* left = pageMap_.get(span->start - 1);
+            left && left->state == Span::State::Free && left->hugetlb == span->hugetlb) {
+            unlink(left);
+            left->npages += span->npages;
+            left->released = left->released && span->released;
+            spans_.deallocate(span);
+            span = left;
+            setBoundaries(span, span);
+        }
+        if (Span* right = pageMap_.get(span->start + span->npages);
+            right && right->state == Span::State::Free && right->hugetlb == span->hugetlb) {
+            unlink(right);
+            span->npages += right->npages;
+            span->released = span->released && right->released;
+            spans_.deallocate(right);
+            setBoundaries(span, span);
+        }
+        return span;
+    }
+
+    void grow(size_t npages) {
+        size_t n = npages > kGrowPages ? npages : kGrowPages;
+        void* region = nullptr;
+        bool hugetlb = false;
+        if (hugePageMode_ != HugePageMode::None) {
+            constexpr size_t hugePages = kHugePageSize >> kPageShift;
+            n = (n + hugePages - 1) & ~(hugePages - 1);
+        }
+        if (hugePageMode_ == HugePageMode::HugeTLB) {
+            region = ::mmap(nullptr, n << kPageShift, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (region == MAP_FAILED) region = nullptr;
+            else hugetlb = true;
+        }
+        if (!region && hugePageMode_ != HugePageMode::None) {
+            region = sysAllocAligned(n << kPageShift, kHugePageSize);
+            ::madvise(region, n << kPageShift, MADV_HUGEPAGE);
+        }
+        if (!region) region = sysAlloc(n << kPageShift);
+
+        Span* span = newSpan(reinterpret_cast<uintptr_t>(region) >> kPageShift, n, Span::State::Free);
+        span->released = !hugetlb;
+        span->hugetlb = hugetlb;
+        regionBytes_ += n << kPageShift;
+        span = coalesce(span);
+        link(span);
+    }
+
+    // 多映射 align 字节, 再把头尾多出的部分还回去
+    static void* sysAllocAligned(size_t bytes, size_t align) {
+        char* raw = static_cast<char*>(sysAlloc(bytes + align));
+        uintptr_t start = (reinterpret_cast<uintptr_t>(raw) + align - 1) & ~(align - 1);
+        char* p = reinterpret_cast<char*>(start);
+        if (p > raw) sysFree(raw, p - raw);
+        sysFree(p + bytes, raw + bytes + align - (p + bytes));
+        return p;
+    }
+
+    // reallocate() 的实现, 调用方持有 mutex_
+    void* resizeLocked(void* p, size_t npages) {
+        uintptr_t page = reinterpret_cast<uintptr_t>(p) >> kPageShift;
+        Span* span = pageMap_.get(page);
+        assert(span && span->start == page && span->state != Span::State::Free);
+        if (span->sizeClass) return nullptr;
+
+        if (span->state == Span::State::Mapped) {
+            // 缩到堆内尺寸时交给调用方搬回堆中
+            if (npages <= kMaxSpanPages) return nullptr;
+            void* q = ::mremap(span->address(), span->bytes(), npages << kPageShift, MREMAP_MAYMOVE);
+            if (q == MAP_FAILED) return nullptr;
+            mappedBytes_ = mappedBytes_ - span->bytes() + (npages << kPageShift);
+            usedBytes_.fetch_add((npages << kPageShift) - span->bytes(), std::memory_order_relaxed);
+            setBoundaries(span, nullptr);
+            span->start = reinterpret_cast<uintptr_t>(q) >> kPageShift;
+            span->npages = npages;
+            setBoundaries(span, span);
+            return q;
+        }
+
+        if (npages > kMaxSpanPages) return nullptr;
+        if (npages < span->npages) {
+            Span* rest = split(span, npages);
+            rest->state = Span::State::Free;
+            usedBytes_.fetch_sub(rest->bytes(), std::memory_order_relaxed);
+            link(coalesce(rest));
+            return p;
+        }
+        if (npages == span->npages) return p;
+
+        Span* right = pageMap_.get(span->start + span->npages);
+        size_t extra = npages - span->npages;
+        if (!right || right->state != Span::State::Free || right->hugetlb != span->hugetlb ||
+            right->npages < extra) {
+            return nullptr;
+        }
+        unlink(right);
+        if (right->npages > extra) link(split(right, extra));
+        span->npages = npages;
+        usedBytes_.fetch_add(extra << kPageShift, std::memory_order_relaxed);
+        spans_.deallocate(right);
+        setBoundaries(span, span);
+        return p;
+    }
+
+    // 分配之后、锁已释放时检查水位, 未越过时只多两次原子读
+    void checkWatermark() {
+        size_t used = usedBytes_.load(std::memory_order_relaxed);
+        if (used >= watermark_.load(std::memory_order_acquire)) [[unlikely]] {
+            if (auto hook = watermarkHook_.load(std::memory_order_relaxed)) hook(used);
+        }
+    }
+
+    Span* allocateMapped(size_t npages) {
+        void* p = sysAlloc(npages << kPageShift);
+        mappedBytes_ += npages << kPageShift;
+        usedBytes_.fetch_add(npages << kPageShift, std::memory_order_relaxed);
+        return newSpan(reinterpret_cast<uintptr_t>(p) >> kPageShift, npages, Span::State::Mapped);
+    }
+
+private:
+    std::mutex mutex_;
+    Span freeLists_[kMaxSpanPages + 1];
+    Span large_;
+    MetadataAllocator<Span> spans_;
+    PageMap<Span*> pageMap_;
+    PageMap<uint8_t> sizeClasses_;
+    HugePageMode hugePageMode_ = HugePageMode::None;
+    size_t regionBytes_ = 0;
+    size_t mappedBytes_ = 0;
+    std::atomic<size_t> usedBytes_{0};
+    std::atomic<size_t> watermark_{SIZE_MAX};
+    std::atomic<void (*)(size_t)> watermarkHook_{nullptr};
+};
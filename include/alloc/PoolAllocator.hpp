@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <memory_resource>
+#include "MemoryPool.hpp"
+
+namespace hspd {
+
+// ==============================================================
+//                    PoolResource / PoolAllocator
+//      让标准容器经由 GlobalPoolManager 分配内存:
+//      PoolResource 用于 std::pmr 容器, PoolAllocator<T> 是无状态的 STL 分配器
+// ==============================================================
+
+namespace pool_detail {
+
+    inline void* allocate(size_t bytes, size_t align) {
+        return GlobalPoolManager::instance().allocateAligned(bytes, align);
+    }
+
+    inline void deallocate(void* p, size_t bytes, size_t align) {
+        GlobalPoolManager::instance().deallocateAligned(p, bytes, align);
+    }
+
+} // namespace pool_detail
+
+class PoolResource : public std::pmr::memory_resource {
+public:
+    // 进程唯一, 故意不析构: 静态对象里的 pmr 容器析构时仍会用到它
+    static PoolResource* instance() {
+        alignas(PoolResource) static unsigned char storage[sizeof(PoolResource)];
+        static PoolResource* resource = new (storage) PoolResource();
+        return resource;
+    }
+
+private:
+    PoolResource() = default;
+
+    void* do_allocate(size_t bytes, size_t align) override {
+        return pool_detail::allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        pool_detail::deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > static_cast<size_t>(-1) / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(pool_detail::allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        pool_detail::deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+};
+
+} // namespace hspd
@@ -1,7 +1,9 @@
 #ifndef ALLOC_HPP
 #define ALLOC_HPP
 #include "MemoryPool.hpp"
+#include "AllocTrace.hpp"
 
+// 设置 HSPD_ALLOC_TRACE 或调用 AllocTrace::start() 后, 每次调用都会记录到分配轨迹
 class Allocator
 {
 public:
@@ -10,12 +12,12 @@ public:
     static auto alloc(Args&&... args) -> T*
     {
         size_t sz = sizeof(T);
-        void* p = gMemoryPool.allocate(sz);
+        void* p = allocateRaw(sz);
         try {
             // 定位new
             return new (p) T(std::forward<Args>(args)...);
         } catch (...) {
-            gMemoryPool.deallocate(p, sz);
+            deallocateRaw(p, sz);
             throw;
         }
     }
@@ -25,7 +27,7 @@ public:
     static auto alloc_array(size_t n) -> T*
     {
         size_t sz = sizeof(T) * n;
-        void* p = gMemoryPool.allocate(sz);
+        void* p = allocateRaw(sz);
         try {
             T* arr = static_cast<T*>(p);
             // 对每个元素进行构造
@@ -39,7 +41,7 @@ public:
             for (size_t i = 0; i < n; ++i) {
                 arr[i].~T();
             }
-            gMemoryPool.deallocate(p, sz);
+            deallocateRaw(p, sz);
             throw;
         }
     }
@@ -49,7 +51,7 @@ public:
     static auto alloc_array(size_t n, Args&&... args) -> T*
     {
         size_t sz = sizeof(T) * n;
-        void* p = gMemoryPool.allocate(sz);
+        void* p = allocateRaw(sz);
         try {
             T* arr = static_cast<T*>(p);
             // 对每个元素使用相同的参数进行构造
@@ -63,18 +65,71 @@ public:
             for (size_t i = 0; i < n; ++i) {
                 arr[i].~T();
             }
-            gMemoryPool.deallocate(p, sz);
+            deallocateRaw(p, sz);
             throw;
         }
     }
 
+    // 批量分配: 构造 n 个对象写入 out, 适合一次建好一组节点(数组元素、定时器、任务节点)。
+    // 每个对象都用同一组参数构造
+    template <typename T, typename... Args>
+    static void alloc_batch(T** out, size_t n, Args&&... args)
+    {
+        GlobalPoolManager::instance().allocateBatch(sizeof(T), out, n);
+        if (AllocTrace::enabled()) [[unlikely]] {
+            for (size_t j = 0; j < n; ++j) AllocTrace::record(AllocOp::Alloc, out[j], sizeof(T));
+        }
+        size_t i = 0;
+        try {
+            for (; i < n; ++i) {
+                new (out[i]) T(args...);
+            }
+        } catch (...) {
+            // 析构已构造的对象, 再整批归还内存
+            for (size_t j = 0; j < i; ++j) {
+                out[j]->~T();
+            }
+            deallocateBatchRaw(sizeof(T), out, n);
+            throw;
+        }
+    }
+
+    // 批量释放由 alloc_batch 或 alloc 得到的对象, 允许含 nullptr
+    template <typename T>
+    static void dealloc_batch(T* const* ptrs, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            if (ptrs[i]) ptrs[i]->~T();
+        }
+        deallocateBatchRaw(sizeof(T), ptrs, n);
+    }
+
+    // 调整原始内存的大小, 保留前 min(oldSize, newSize) 字节; 能原地完成时不复制
+    static void* reallocate(void* p, size_t oldSize, size_t newSize)
+    {
+        if (!AllocTrace::enabled()) [[likely]] {
+            return GlobalPoolManager::instance().reallocate(p, oldSize, newSize);
+        }
+        AllocTrace::record(AllocOp::ReallocBegin, p, oldSize);
+        void* q;
+        try {
+            q = GlobalPoolManager::instance().reallocate(p, oldSize, newSize);
+        } catch (...) {
+            // 失败时原内存不变
+            AllocTrace::record(AllocOp::ReallocEnd, p, oldSize);
+            throw;
+        }
+        AllocTrace::record(AllocOp::ReallocEnd, q, newSize);
+        return q;
+    }
+
     // 释放普通对象
     template <typename T>
     static void dealloc(T* p)
     {
         if (p) {
             p->~T();
-            gMemoryPool.deallocate(p, sizeof(T));
+            deallocateRaw(p, sizeof(T));
         }
     }
 
@@ -88,8 +143,36 @@ public:
                 p[i].~T();
             }
             // 释放内存
-            gMemoryPool.deallocate(p, sizeof(T) * n);
+            deallocateRaw(p, sizeof(T) * n);
+        }
+    }
+
+    // 原始内存(不构造对象), 与 reallocate 配对使用, 同样记录到分配轨迹。
+    // 分配在返回之后记录, 释放在归还之前记录
+    static void* allocateRaw(size_t sz)
+    {
+        void* p = GlobalPoolManager::instance().allocate(sz);
+        if (AllocTrace::enabled()) [[unlikely]] AllocTrace::record(AllocOp::Alloc, p, sz);
+        return p;
+    }
+
+    static void deallocateRaw(void* p, size_t sz)
+    {
+        if (AllocTrace::enabled()) [[unlikely]] AllocTrace::record(AllocOp::Free, p, sz);
+        GlobalPoolManager::instance().deallocate(p, sz);
+    }
+
+private:
+
+    template <typename T>
+    static void deallocateBatchRaw(size_t sz, T* const* ptrs, size_t n)
+    {
+        if (AllocTrace::enabled()) [[unlikely]] {
+            for (size_t i = 0; i < n; ++i) {
+                if (ptrs[i]) AllocTrace::record(AllocOp::Free, ptrs[i], sz);
+            }
         }
+        GlobalPoolManager::instance().deallocateBatch(sz, ptrs, n);
     }
 };
 
@@ -7,13 +7,14 @@
 #include <type_traits>
 #include <utility>      // std::exchange
 #include <tools/ThreadPool.hpp>
+#include <coro/FrameAllocator.hpp>
 
 namespace hspd
 {
     // ======================= Awaitable<T> =======================
     template <typename T>
     struct Awaitable {
-        struct promise_type {
+        struct promise_type : PooledFrame {
             ThreadPool* executor = nullptr;
             std::coroutine_handle<> awaiting;
             std::optional<T> value;
@@ -105,7 +106,7 @@ namespace hspd
     // ======================= Awaitable<void> =======================
     template <>
     struct Awaitable<void> {
-        struct promise_type {
+        struct promise_type : PooledFrame {
             ThreadPool* executor = nullptr;
             std::coroutine_handle<> awaiting;
             std::exception_ptr exception;
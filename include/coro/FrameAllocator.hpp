@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <alloc/MemoryPool.hpp>
+
+namespace hspd
+{
+    // ======================= FrameAllocator =======================
+    // 协程帧按 size-class 从全局内存池分配, 前面再加一层每线程的小缓存:
+    // 同一尺寸的帧在同一线程上反复创建/销毁时只做一次链表 push/pop。
+    // 帧可以在任意线程销毁, 归还到销毁线程的缓存即可
+    class FrameAllocator {
+    public:
+        static void* allocate(size_t size) {
+            int cls = size_to_class(size);
+            if (cls < 0 || tlsDead_) {
+                return GlobalPoolManager::instance().allocate(size);
+            }
+            FrameCache& cache = tlsCache();
+            if (void* p = cache.heads[cls]) [[likely]] {
+                cache.heads[cls] = *static_cast<void**>(p);
+                cache.counts[cls]--;
+                return p;
+            }
+            return GlobalPoolManager::instance().allocate(class_to_size(cls));
+        }
+
+        static void deallocate(void* p, size_t size) noexcept {
+            int cls = size_to_class(size);
+            if (cls < 0 || tlsDead_) {
+                GlobalPoolManager::instance().deallocate(p, size);
+                return;
+            }
+            FrameCache& cache = tlsCache();
+            if (cache.counts[cls] < kMaxCachedFrames) [[likely]] {
+                *static_cast<void**>(p) = cache.heads[cls];
+                cache.heads[cls] = p;
+                cache.counts[cls]++;
+                return;
+            }
+            GlobalPoolManager::instance().deallocate(p, class_to_size(cls));
+        }
+
+    private:
+        // 每个 size-class 最多缓存的帧数
+        static constexpr uint32_t kMaxCachedFrames = 16;
+
+        struct FrameCache {
+            void* heads[NUM_CLASSES] = {};
+            uint32_t counts[NUM_CLASSES] = {};
+
+            // 线程退出: 缓存的帧还给内存池, 之后的分配/释放直接走内存池
+            ~FrameCache() {
+                tlsDead_ = true;
+                for (int cls = 0; cls < NUM_CLASSES; cls++) {
+                    while (void* p = heads[cls]) {
+                        heads[cls] = *static_cast<void**>(p);
+                        GlobalPoolManager::instance().deallocate(p, class_to_size(cls));
+                    }
+                }
+            }
+        };
+
+        static FrameCache& tlsCache() {
+            thread_local FrameCache cache;
+            return cache;
+        }
+
+        static inline thread_local bool tlsDead_ = false;
+    };
+
+    // promise_type 继承它即可让协程帧走 FrameAllocator
+    struct PooledFrame {
+        static void* operator new(size_t size) {
+            return FrameAllocator::allocate(size);
+        }
+
+        static void operator delete(void* p, size_t size) noexcept {
+            FrameAllocator::deallocate(p, size);
+        }
+    };
+}
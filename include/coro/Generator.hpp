@@ -8,11 +8,12 @@
 #include <utility>
 #include <any>
 #include <optional>
+#include <coro/FrameAllocator.hpp>
 template <typename T>
 struct Generator
 {
 public:
-    struct promise_type
+    struct promise_type : hspd::PooledFrame
     {
         std::optional<T> value_;
         std::exception_ptr exception_ = nullptr;
@@ -8,11 +8,12 @@
 #include <future>
 #include <optional>
 #include <tools/ThreadPool.hpp>
+#include <coro/FrameAllocator.hpp>
 #include <Coro/Scheduler.hpp>
 template <typename T>
 struct Task
 {
-    struct promise_type
+    struct promise_type : hspd::PooledFrame
     {
         std::promise<T> value_;
 
@@ -60,7 +61,7 @@ struct Task
 template <>
 struct Task<void>
 {
-    struct promise_type
+    struct promise_type : hspd::PooledFrame
     {
         std::promise<bool> ready_;
         Task get_return_object() { 
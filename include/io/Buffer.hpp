@@ -1,30 +1,144 @@
 #pragma once
-#include <vector>
 #include <string>
+#include <string_view>
+#include <span>
+#include <atomic>
+#include <utility>
 #include <algorithm>
 #include <cstring>
 #include <unistd.h>
 #include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <alloc/alloc.hpp>
 
 namespace hspd
 {
+    namespace buffer_detail {
+
+        // Buffer 存储块的头部, 数据紧随其后; 引用计数由 Buffer 与 BufferSlice 共享
+        struct Storage {
+            std::atomic<size_t> refs;
+            size_t bytes;       // 含头部的分配尺寸
+
+            char* data() { return reinterpret_cast<char*>(this + 1); }
+
+            static Storage* create(size_t capacity) {
+                size_t bytes = sizeof(Storage) + capacity;
+                return new (Allocator::allocateRaw(bytes)) Storage{ {1}, bytes };
+            }
+
+            void retain() noexcept { refs.fetch_add(1, std::memory_order_relaxed); }
+
+            void release() noexcept {
+                if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    size_t n = bytes;
+                    this->~Storage();
+                    Allocator::deallocateRaw(this, n);
+                }
+            }
+        };
+
+    } // namespace buffer_detail
+
+    // ==============================================================
+    //                          BufferSlice
+    //      Buffer 中一段数据的只读引用: 持有存储块的引用计数, 数据在切片
+    //      存活期间保持不变, 以 string_view 访问而不复制。Buffer 需要改写
+    //      被切片引用的区域(回卷、前移、扩容)时会换用新的存储块。
+    //      外部内存视图没有存储块, 从视图切片时复制到新的存储块
+    // ==============================================================
+    class BufferSlice {
+    public:
+        BufferSlice() = default;
+        ~BufferSlice() { if (storage_) storage_->release(); }
+
+        BufferSlice(const BufferSlice& other) noexcept
+            : storage_(other.storage_), data_(other.data_), size_(other.size_) {
+            if (storage_) storage_->retain();
+        }
+        BufferSlice(BufferSlice&& other) noexcept
+            : storage_(std::exchange(other.storage_, nullptr)),
+            data_(std::exchange(other.data_, nullptr)),
+            size_(std::exchange(other.size_, 0)) {}
+        BufferSlice& operator=(BufferSlice other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        void swap(BufferSlice& other) noexcept {
+            std::swap(storage_, other.storage_);
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+        }
+
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        std::string_view view() const { return { data_, size_ }; }
+        operator std::string_view() const { return view(); }
+        std::string toString() const { return std::string(data_, size_); }
+
+        /// 同一存储块上的子区间 [pos, pos + len)
+        BufferSlice subslice(size_t pos, size_t len = std::string_view::npos) const {
+            pos = std::min(pos, size_);
+            len = std::min(len, size_ - pos);
+            if (storage_) storage_->retain();
+            return BufferSlice(storage_, data_ + pos, len);
+        }
+
+    private:
+        friend class Buffer;
+
+        // 调用方已为 storage 增加引用
+        BufferSlice(buffer_detail::Storage* storage, const char* data, size_t size) noexcept
+            : storage_(storage), data_(data), size_(size) {}
+
+        buffer_detail::Storage* storage_ = nullptr;
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
     class Buffer {
     public:
         explicit Buffer(size_t initialSize = 1024);
+        ~Buffer();
+
+        /// 不持有的视图: 以外部内存(mmap 的文件、std::span 等)为可读数据, 不复制;
+        /// 外部内存须比视图活得久。写入时先复制到自己的存储, 切片复制所取的那一段
+        static Buffer view(std::span<const char> memory);
+
+        Buffer(const Buffer& other);
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer other) noexcept;
+
+        void swap(Buffer& other) noexcept;
 
         size_t readableBytes() const { return writeIndex_ - readIndex_; }
-        size_t writableBytes() const { return buffer_.size() - writeIndex_; }
+        size_t writableBytes() const { return capacity_ - writeIndex_; }
         size_t prependableBytes() const { return readIndex_; }
 
         /// 可读数据的起始位置
-        const char* peek() const { return buffer_.data() + readIndex_; }
+        const char* peek() const { return buffer_ + readIndex_; }
 
         /// 取走 len 字节
         void retrieve(size_t len);
         void retrieveAll();
+
+        /// 供 ObjectPool 回收: 清空内容, 保留不超过 kMaxRetainedSize 的容量
+        void reset();
         std::string retrieveAsString(size_t len);
         std::string retrieveAllAsString();
 
+        /// 引用从第 offset 个可读字节起的 len 字节, 不取走、不复制(视图上复制这一段)
+        BufferSlice slice(size_t offset, size_t len) const;
+        /// 取走 len 字节并以切片返回, 不复制
+        BufferSlice retrieveAsSlice(size_t len);
+        BufferSlice retrieveAllAsSlice() { return retrieveAsSlice(readableBytes()); }
+
+        /// 外部内存视图
+        bool isView() const { return storage_ == nullptr; }
+
         /// 添加数据到 Buffer
         void append(const char* data, size_t len);
         void append(const std::string& str) { append(str.data(), str.size()); }
@@ -32,30 +146,129 @@ namespace hspd
         /// 写 socket
         ssize_t writeFd(int fd, int* savedErrno);
 
-        /// 从 socket 读
+        /// 从 socket 读: 直接读入预留的可写区间, 区间大小随最近几次读到的字节数调整
         ssize_t readFd(int fd, int* savedErrno);
 
+        /// 下一次 readFd 预留的可写字节数
+        size_t readHint() const { return readHint_; }
+
         /// 返回可写起点
-        char* beginWrite() { return buffer_.data() + writeIndex_; }
-        const char* beginWrite() const { return buffer_.data() + writeIndex_; }
+        char* beginWrite() { return buffer_ + writeIndex_; }
+        const char* beginWrite() const { return buffer_ + writeIndex_; }
 
     private:
+        struct ViewTag {};
+        Buffer(ViewTag, std::span<const char> memory);
+
         void makeSpace(size_t len);
+        void resize(size_t capacity);
+        void detach(size_t capacity);
+        void adaptReadHint(int fd, size_t n, size_t writable);
+
+        // 存储块只被自己引用时, 才能改写可读区间之前的字节
+        bool exclusive() const {
+            return storage_ && storage_->refs.load(std::memory_order_acquire) == 1;
+        }
 
     private:
-        std::vector<char> buffer_;
+        // 存储直接来自内存池, 扩容走 Allocator::reallocate, 大缓冲可以原地增长;
+        // 有切片引用时 storage_ 为共享, 视图的 storage_ 为空
+        buffer_detail::Storage* storage_;
+        char* buffer_;
+        size_t capacity_;
         size_t readIndex_;
         size_t writeIndex_;
-        static const size_t kCheapPrepend = 8;
+        // 读满预留区间时翻倍(有 FIONREAD 时至少为内核中待读的字节数),
+        // 连续两次不足一半时减半
+        size_t readHint_ = kInitialReadHint;
+        unsigned shortReads_ = 0;
+        static constexpr size_t kCheapPrepend = 8;
+        static constexpr size_t kMaxRetainedSize = 64 * 1024;
+        static constexpr size_t kInitialReadHint = 16 * 1024;
+        static constexpr size_t kMinReadHint = 2 * 1024;
+        static constexpr size_t kMaxReadHint = 1024 * 1024;
     };
 
 
-    Buffer::Buffer(size_t initialSize)
-        : buffer_(kCheapPrepend + initialSize),
+    inline Buffer::Buffer(size_t initialSize)
+        : storage_(buffer_detail::Storage::create(kCheapPrepend + initialSize)),
+        buffer_(storage_->data()),
+        capacity_(kCheapPrepend + initialSize),
         readIndex_(kCheapPrepend),
         writeIndex_(kCheapPrepend) {}
 
-    void Buffer::retrieve(size_t len) {
+    inline Buffer::~Buffer() {
+        if (storage_) storage_->release();
+    }
+
+    inline Buffer::Buffer(ViewTag, std::span<const char> memory)
+        : storage_(nullptr),
+        buffer_(const_cast<char*>(memory.data())),
+        capacity_(memory.size()),
+        readIndex_(0),
+        writeIndex_(memory.size()) {}
+
+    inline Buffer Buffer::view(std::span<const char> memory) {
+        return Buffer(ViewTag{}, memory);
+    }
+
+    inline Buffer::Buffer(const Buffer& other)
+        : Buffer(other.readableBytes()) {
+        std::copy(other.peek(), other.peek() + other.readableBytes(), beginWrite());
+        writeIndex_ += other.readableBytes();
+    }
+
+    inline Buffer::Buffer(Buffer&& other) noexcept
+        : storage_(std::exchange(other.storage_, nullptr)),
+        buffer_(std::exchange(other.buffer_, nullptr)),
+        capacity_(std::exchange(other.capacity_, 0)),
+        readIndex_(std::exchange(other.readIndex_, 0)),
+        writeIndex_(std::exchange(other.writeIndex_, 0)),
+        readHint_(other.readHint_),
+        shortReads_(other.shortReads_) {}
+
+    inline Buffer& Buffer::operator=(Buffer other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    inline void Buffer::swap(Buffer& other) noexcept {
+        std::swap(storage_, other.storage_);
+        std::swap(buffer_, other.buffer_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(readIndex_, other.readIndex_);
+        std::swap(writeIndex_, other.writeIndex_);
+        std::swap(readHint_, other.readHint_);
+        std::swap(shortReads_, other.shortReads_);
+    }
+
+    inline void Buffer::resize(size_t capacity) {
+        if (!exclusive()) {
+            detach(capacity);
+            return;
+        }
+        size_t bytes = sizeof(buffer_detail::Storage) + capacity;
+        storage_ = static_cast<buffer_detail::Storage*>(Allocator::reallocate(storage_, storage_->bytes, bytes));
+        storage_->bytes = bytes;
+        buffer_ = storage_->data();
+        capacity_ = capacity;
+    }
+
+    // 换用新的存储块, 可读数据复制到 kCheapPrepend 处; 旧块留给仍在引用它的切片
+    inline void Buffer::detach(size_t capacity) {
+        size_t readable = readableBytes();
+        capacity = std::max(capacity, kCheapPrepend + readable);
+        buffer_detail::Storage* storage = buffer_detail::Storage::create(capacity);
+        std::copy(peek(), peek() + readable, storage->data() + kCheapPrepend);
+        if (storage_) storage_->release();
+        storage_ = storage;
+        buffer_ = storage->data();
+        capacity_ = capacity;
+        readIndex_ = kCheapPrepend;
+        writeIndex_ = kCheapPrepend + readable;
+    }
+
+    inline void Buffer::retrieve(size_t len) {
         if (len < readableBytes()) {
             readIndex_ += len;
         } else {
@@ -63,22 +276,56 @@ namespace hspd
         }
     }
 
-    void Buffer::retrieveAll() {
-        readIndex_ = writeIndex_ = kCheapPrepend;
+    inline void Buffer::retrieveAll() {
+        // 切片可能仍引用之前的数据, 只有独占存储时才回到开头
+        if (exclusive()) {
+            readIndex_ = writeIndex_ = kCheapPrepend;
+        } else {
+            readIndex_ = writeIndex_;
+        }
     }
 
-    std::string Buffer::retrieveAsString(size_t len) {
+    inline void Buffer::reset() {
+        retrieveAll();
+        readHint_ = kInitialReadHint;
+        shortReads_ = 0;
+        if (capacity_ > kCheapPrepend + kMaxRetainedSize) {
+            resize(kCheapPrepend + kMaxRetainedSize);
+        }
+    }
+
+    inline std::string Buffer::retrieveAsString(size_t len) {
         len = std::min(len, readableBytes());
         std::string result(peek(), len);
         retrieve(len);
         return result;
     }
 
-    std::string Buffer::retrieveAllAsString() {
+    inline std::string Buffer::retrieveAllAsString() {
         return retrieveAsString(readableBytes());
     }
 
-    void Buffer::append(const char* data, size_t len) {
+    inline BufferSlice Buffer::slice(size_t offset, size_t len) const {
+        offset = std::min(offset, readableBytes());
+        len = std::min(len, readableBytes() - offset);
+        if (!storage_) {
+            // 视图: 切片可能比外部内存活得久, 复制到自己的存储块
+            if (len == 0) return BufferSlice();
+            buffer_detail::Storage* storage = buffer_detail::Storage::create(len);
+            std::copy(peek() + offset, peek() + offset + len, storage->data());
+            return BufferSlice(storage, storage->data(), len);
+        }
+        storage_->retain();
+        return BufferSlice(storage_, peek() + offset, len);
+    }
+
+    inline BufferSlice Buffer::retrieveAsSlice(size_t len) {
+        BufferSlice result = slice(0, len);
+        retrieve(result.size());
+        return result;
+    }
+
+    inline void Buffer::append(const char* data, size_t len) {
         if (len > writableBytes()) {
             makeSpace(len);
         }
@@ -86,50 +333,66 @@ namespace hspd
         writeIndex_ += len;
     }
 
-    void Buffer::makeSpace(size_t len) {
-        if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-            // 扩容
-            buffer_.resize(writeIndex_ + len);
+    inline void Buffer::makeSpace(size_t len) {
+        if (!exclusive()) {
+            // 有切片引用或是视图: 不能前移或原地扩容
+            detach(kCheapPrepend + readableBytes() + std::max(len, readableBytes()));
+        } else if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
+            // 扩容: 至少翻倍, 保证追加的均摊复杂度
+            resize(std::max(writeIndex_ + len, capacity_ * 2));
         } else {
             // 数据前移
             size_t readable = readableBytes();
-            std::copy(buffer_.data() + readIndex_,
-                    buffer_.data() + writeIndex_,
-                    buffer_.data() + kCheapPrepend);
+            std::copy(buffer_ + readIndex_,
+                    buffer_ + writeIndex_,
+                    buffer_ + kCheapPrepend);
             readIndex_ = kCheapPrepend;
             writeIndex_ = readIndex_ + readable;
         }
     }
 
-    ssize_t Buffer::readFd(int fd, int* savedErrno) {
-        // 使用 readv：优先读入剩余空间，不够则读入栈上的临时缓冲
-        char extraBuf[65536];
-        struct iovec vecs[2];
+    inline ssize_t Buffer::readFd(int fd, int* savedErrno) {
+        // 空缓冲远大于最近的读取量时先缩小, 再预留 readHint_ 字节; 数据只复制一次
+        if (readableBytes() == 0 && capacity_ > kCheapPrepend + std::max(kMaxRetainedSize, readHint_ * 4)) {
+            retrieveAll();
+            resize(kCheapPrepend + readHint_ * 2);
+        }
+        if (writableBytes() < readHint_) {
+            makeSpace(readHint_);
+        }
 
         const size_t writable = writableBytes();
-
-        vecs[0].iov_base = beginWrite();
-        vecs[0].iov_len  = writable;
-
-        vecs[1].iov_base = extraBuf;
-        vecs[1].iov_len  = sizeof(extraBuf);
-
-        const int iovcnt = writable < sizeof(extraBuf) ? 2 : 1;
-        ssize_t n = ::readv(fd, vecs, iovcnt);
-
+        ssize_t n = ::read(fd, beginWrite(), writable);
         if (n < 0) {
             *savedErrno = errno;
-        } else if (n <= (ssize_t)writable) {
-            writeIndex_ += n;
-        } else {
-            writeIndex_ = buffer_.size();
-            append(extraBuf, n - writable);
+            return n;
         }
-
+        writeIndex_ += n;
+        adaptReadHint(fd, static_cast<size_t>(n), writable);
         return n;
     }
 
-    ssize_t Buffer::writeFd(int fd, int* savedErrno) {
+    inline void Buffer::adaptReadHint(int fd, size_t n, size_t writable) {
+        if (n == writable) {
+            // 读满了, 内核里可能还有数据
+            size_t want = readHint_ * 2;
+            int pending = 0;
+            if (::ioctl(fd, FIONREAD, &pending) == 0 && pending > 0) {
+                want = std::max(want, static_cast<size_t>(pending));
+            }
+            readHint_ = std::min(want, kMaxReadHint);
+            shortReads_ = 0;
+        } else if (n < readHint_ / 2) {
+            if (++shortReads_ >= 2) {
+                readHint_ = std::max(readHint_ / 2, kMinReadHint);
+                shortReads_ = 0;
+            }
+        } else {
+            shortReads_ = 0;
+        }
+    }
+
+    inline ssize_t Buffer::writeFd(int fd, int* savedErrno) {
         ssize_t n = ::write(fd, peek(), readableBytes());
         if (n < 0) {
             *savedErrno = errno;
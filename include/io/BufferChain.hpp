@@ -0,0 +1,294 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <alloc/MemoryPool.hpp>
+
+namespace hspd
+{
+    // ==============================================================
+    //                         BufferChain
+    //      由固定大小的块串成的缓冲: 追加只在尾块写入或挂上新块,
+    //      已有数据从不移动或复制; 取走的块立即归还。
+    //      块取自内存池的 16 KiB 页对齐 size-class, readFd / writeFd
+    //      各用一次 readv / writev 覆盖整条链
+    // ==============================================================
+    class BufferChain {
+    public:
+        static constexpr size_t kBlockSize = 16 * 1024;
+
+        BufferChain() = default;
+        ~BufferChain();
+
+        BufferChain(const BufferChain&) = delete;
+        BufferChain& operator=(const BufferChain&) = delete;
+        BufferChain(BufferChain&& other) noexcept;
+        BufferChain& operator=(BufferChain&& other) noexcept;
+
+        void swap(BufferChain& other) noexcept;
+
+        size_t readableBytes() const { return readable_; }
+        bool empty() const { return readable_ == 0; }
+
+        /// 第一个块中连续的可读数据
+        std::string_view front() const;
+
+        /// 依次以每个块中的可读数据调用 f(std::string_view), 不取走
+        template <typename F>
+        void forEachBlock(F&& f) const {
+            for (const Block* b = head_; b; b = b->next) {
+                if (b->readableBytes() > 0) f(std::string_view(b->data() + b->readIndex, b->readableBytes()));
+            }
+        }
+
+        /// 从第 offset 个可读字节起复制最多 len 字节到 out, 不取走; 返回复制的字节数
+        size_t peek(char* out, size_t len, size_t offset = 0) const;
+
+        /// 取走 len 字节
+        void retrieve(size_t len);
+        void retrieveAll();
+
+        /// 供 ObjectPool 回收: 清空内容, 最多保留一个块和一个备用块
+        void reset() { retrieveAll(); }
+        std::string retrieveAsString(size_t len);
+        std::string retrieveAllAsString();
+
+        /// 添加数据到链尾
+        void append(const char* data, size_t len);
+        void append(std::string_view str) { append(str.data(), str.size()); }
+
+        /// 写 socket: 一次 writev 覆盖至多 kMaxIov 个块
+        ssize_t writeFd(int fd, int* savedErrno);
+
+        /// 从 socket 读: 尾块剩余空间、至多一个新块与栈上 kReadSize 字节的溢出区合成一次 readv
+        ssize_t readFd(int fd, int* savedErrno);
+
+    private:
+        struct Block {
+            Block* next;
+            size_t readIndex;
+            size_t writeIndex;
+
+            char* data() { return reinterpret_cast<char*>(this + 1); }
+            const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+            size_t readableBytes() const { return writeIndex - readIndex; }
+            size_t writableBytes() const { return kBlockCapacity - writeIndex; }
+        };
+
+        static constexpr size_t kBlockCapacity = kBlockSize - sizeof(Block);
+        static constexpr size_t kReadSize = 64 * 1024;
+        static constexpr size_t kMinTailRoom = 4 * 1024;
+        static constexpr int kMaxIov = 64;
+
+        Block* newBlock();
+        void freeBlock(Block* b) noexcept;
+        void pushBack(Block* b) noexcept;
+        void popFront() noexcept;
+
+    private:
+        Block* head_ = nullptr;
+        Block* tail_ = nullptr;
+        Block* spare_ = nullptr;    // 备用的空块, 避免读写交替时反复分配
+        size_t readable_ = 0;
+    };
+
+
+    inline BufferChain::~BufferChain() {
+        while (head_) {
+            Block* next = head_->next;
+            GlobalPoolManager::instance().deallocateAligned(head_, kBlockSize, kPageSize);
+            head_ = next;
+        }
+        if (spare_) GlobalPoolManager::instance().deallocateAligned(spare_, kBlockSize, kPageSize);
+    }
+
+    inline BufferChain::BufferChain(BufferChain&& other) noexcept
+        : head_(std::exchange(other.head_, nullptr)),
+        tail_(std::exchange(other.tail_, nullptr)),
+        spare_(std::exchange(other.spare_, nullptr)),
+        readable_(std::exchange(other.readable_, 0)) {}
+
+    inline BufferChain& BufferChain::operator=(BufferChain&& other) noexcept {
+        BufferChain tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    }
+
+    inline void BufferChain::swap(BufferChain& other) noexcept {
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        std::swap(spare_, other.spare_);
+        std::swap(readable_, other.readable_);
+    }
+
+    inline BufferChain::Block* BufferChain::newBlock() {
+        Block* b = std::exchange(spare_, nullptr);
+        if (!b) b = static_cast<Block*>(GlobalPoolManager::instance().allocateAligned(kBlockSize, kPageSize));
+        b->next = nullptr;
+        b->readIndex = b->writeIndex = 0;
+        return b;
+    }
+
+    inline void BufferChain::freeBlock(Block* b) noexcept {
+        if (!spare_) {
+            spare_ = b;
+        } else {
+            GlobalPoolManager::instance().deallocateAligned(b, kBlockSize, kPageSize);
+        }
+    }
+
+    inline void BufferChain::pushBack(Block* b) noexcept {
+        if (tail_) tail_->next = b;
+        else head_ = b;
+        tail_ = b;
+    }
+
+    inline void BufferChain::popFront() noexcept {
+        Block* b = head_;
+        head_ = b->next;
+        if (!head_) tail_ = nullptr;
+        freeBlock(b);
+    }
+
+    inline std::string_view BufferChain::front() const {
+        if (!head_) return {};
+        return { head_->data() + head_->readIndex, head_->readableBytes() };
+    }
+
+    inline size_t BufferChain::peek(char* out, size_t len, size_t offset) const {
+        size_t copied = 0;
+        for (const Block* b = head_; b && copied < len; b = b->next) {
+            size_t avail = b->readableBytes();
+            if (offset >= avail) {
+                offset -= avail;
+                continue;
+            }
+            size_t n = std::min(avail - offset, len - copied);
+            std::memcpy(out + copied, b->data() + b->readIndex + offset, n);
+            copied += n;
+            offset = 0;
+        }
+        return copied;
+    }
+
+    inline void BufferChain::retrieve(size_t len) {
+        len = std::min(len, readable_);
+        readable_ -= len;
+        while (len > 0) {
+            size_t n = std::min(len, head_->readableBytes());
+            head_->readIndex += n;
+            len -= n;
+            if (head_->readableBytes() == 0) {
+                if (head_ == tail_) {
+                    // 保留尾块继续写入
+                    head_->readIndex = head_->writeIndex = 0;
+                } else {
+                    popFront();
+                }
+            }
+        }
+    }
+
+    inline void BufferChain::retrieveAll() {
+        retrieve(readable_);
+    }
+
+    inline std::string BufferChain::retrieveAsString(size_t len) {
+        len = std::min(len, readable_);
+        std::string result(len, '\0');
+        peek(result.data(), len);
+        retrieve(len);
+        return result;
+    }
+
+    inline std::string BufferChain::retrieveAllAsString() {
+        return retrieveAsString(readable_);
+    }
+
+    inline void BufferChain::append(const char* data, size_t len) {
+        while (len > 0) {
+            if (!tail_ || tail_->writableBytes() == 0) pushBack(newBlock());
+            size_t n = std::min(len, tail_->writableBytes());
+            std::memcpy(tail_->data() + tail_->writeIndex, data, n);
+            tail_->writeIndex += n;
+            readable_ += n;
+            data += n;
+            len -= n;
+        }
+    }
+
+    // 尾块剩余不足 kMinTailRoom 时才取一个新块(优先用备用块), 没用到就放回备用;
+    // 超出的数据先落在栈上, 再追加到链尾, 只为真正收到的数据分配块,
+    // 闲置连接上的小读取不经过分配器
+    inline ssize_t BufferChain::readFd(int fd, int* savedErrno) {
+        char extra[kReadSize];
+        struct iovec vecs[3];
+        int iovcnt = 0;
+
+        const size_t tailWritable = tail_ ? tail_->writableBytes() : 0;
+        if (tailWritable > 0) {
+            vecs[iovcnt].iov_base = tail_->data() + tail_->writeIndex;
+            vecs[iovcnt].iov_len = tailWritable;
+            iovcnt++;
+        }
+        Block* fresh = nullptr;
+        if (tailWritable < kMinTailRoom) {
+            fresh = newBlock();
+            vecs[iovcnt].iov_base = fresh->data();
+            vecs[iovcnt].iov_len = kBlockCapacity;
+            iovcnt++;
+        }
+        vecs[iovcnt].iov_base = extra;
+        vecs[iovcnt].iov_len = sizeof(extra);
+        iovcnt++;
+
+        ssize_t n = ::readv(fd, vecs, iovcnt);
+        if (n < 0) *savedErrno = errno;
+
+        // 读到的数据依次落在尾块、新块与溢出区中
+        size_t left = n > 0 ? static_cast<size_t>(n) : 0;
+        size_t take = std::min(left, tailWritable);
+        if (take > 0) {
+            tail_->writeIndex += take;
+            readable_ += take;
+            left -= take;
+        }
+        if (fresh) {
+            if (left > 0) {
+                fresh->writeIndex = std::min(left, kBlockCapacity);
+                readable_ += fresh->writeIndex;
+                left -= fresh->writeIndex;
+                pushBack(fresh);
+            } else {
+                freeBlock(fresh);
+            }
+        }
+        if (left > 0) append(extra, left);
+        return n;
+    }
+
+    inline ssize_t BufferChain::writeFd(int fd, int* savedErrno) {
+        struct iovec vecs[kMaxIov];
+        int iovcnt = 0;
+        for (Block* b = head_; b && iovcnt < kMaxIov; b = b->next) {
+            if (b->readableBytes() == 0) continue;
+            vecs[iovcnt].iov_base = b->data() + b->readIndex;
+            vecs[iovcnt].iov_len = b->readableBytes();
+            iovcnt++;
+        }
+        if (iovcnt == 0) return 0;
+
+        ssize_t n = ::writev(fd, vecs, iovcnt);
+        if (n < 0) {
+            *savedErrno = errno;
+            return n;
+        }
+        retrieve(n);
+        return n;
+    }
+}
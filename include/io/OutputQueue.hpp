@@ -0,0 +1,266 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include <io/Buffer.hpp>
+#include <io/BufferChain.hpp>
+#include <alloc/PoolAllocator.hpp>
+
+namespace hspd
+{
+    // ==============================================================
+    //                         OutputQueue
+    //      连接的待发送队列: 依次接受 Buffer、BufferChain、带生命周期句柄的
+    //      string_view 与文件区间, writeFd 用一次 writev(至多 IOV_MAX 段)
+    //      发出队首连续的内存数据, 队首为文件区间时用 sendfile。
+    //      不超过 kCoalesceBytes 的小写入复制进暂存块并与相邻的小写入合并为
+    //      同一段, 同一轮处理中产生的多个小响应只占一段 iovec。
+    //      与 Buffer 一样不加锁, 属于连接所在的协程
+    // ==============================================================
+    class OutputQueue {
+    public:
+        /// 持有被引用数据的生命周期, 数据发出后释放
+        using Handle = std::shared_ptr<const void>;
+
+        static constexpr size_t kCoalesceBytes = 1024;
+
+        OutputQueue() = default;
+        OutputQueue(OutputQueue&& other) noexcept;
+        OutputQueue& operator=(OutputQueue&& other) noexcept;
+
+        size_t pendingBytes() const { return pending_; }
+        bool empty() const { return head_ == entries_.size(); }
+
+        /// 复制数据; 小写入与前一个小写入合并
+        void append(const char* data, size_t len);
+        void append(std::string_view str) { append(str.data(), str.size()); }
+        /// 字符串字面量等以 '\0' 结尾的字符串; 否则与 append(std::string&&) 有歧义
+        void append(const char* str) { append(std::string_view(str)); }
+
+        /// 不复制: owner 保证 data 在发出之前有效; 小写入仍然复制合并
+        void append(std::string_view data, Handle owner);
+
+        /// 取得 buffer 的所有权, 发出其可读数据
+        void append(Buffer&& buffer);
+        void append(BufferChain&& chain);
+        void append(std::string&& str);
+
+        /// 文件 fd 的 [offset, offset + len), 以 sendfile 发出; owner 可以持有 fd
+        void appendFile(int fd, off_t offset, size_t len, Handle owner = nullptr);
+
+        /// 丢弃全部待发送数据
+        void clear();
+
+        /// 发送队首的数据: 内存段一次 writev, 文件区间一次 sendfile
+        ssize_t writeFd(int fd, int* savedErrno);
+
+    private:
+        struct StageBlock {
+            static constexpr size_t kSize = 4096;
+            size_t used = 0;
+            char data[kSize];
+        };
+
+        struct Entry {
+            const char* data;       // 内存段的剩余数据; 文件区间为 nullptr
+            size_t len;
+            int fileFd;
+            off_t fileOffset;
+            Handle owner;
+        };
+
+        template <typename T, typename... Args>
+        static std::shared_ptr<T> makeShared(Args&&... args) {
+            return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+        }
+
+        void push(const char* data, size_t len, Handle owner);
+        void consume(size_t n);
+
+        static constexpr size_t kCompactEntries = 64;
+
+#ifdef IOV_MAX
+        static constexpr int kMaxIov = IOV_MAX;
+#else
+        static constexpr int kMaxIov = 1024;
+#endif
+
+    private:
+        // 用 vector 加队首下标而不是 deque: deque 的移动构造会分配内存, 移动可能抛出,
+        // 而 Socket 与 ObjectPool<Socket> 依赖 noexcept 的移动
+        std::vector<Entry, PoolAllocator<Entry>> entries_;
+        size_t head_ = 0;                       // 队首在 entries_ 中的下标, 之前的段已发出
+        std::shared_ptr<StageBlock> stage_;     // 当前暂存块, 尾部仍可追加
+        size_t pending_ = 0;
+    };
+
+    static_assert(std::is_nothrow_move_constructible_v<OutputQueue> && std::is_nothrow_move_assignable_v<OutputQueue>);
+
+
+    inline OutputQueue::OutputQueue(OutputQueue&& other) noexcept
+        : entries_(std::move(other.entries_)),
+        head_(std::exchange(other.head_, 0)),
+        stage_(std::move(other.stage_)),
+        pending_(std::exchange(other.pending_, 0)) {
+        other.entries_.clear();
+    }
+
+    inline OutputQueue& OutputQueue::operator=(OutputQueue&& other) noexcept {
+        entries_ = std::move(other.entries_);
+        other.entries_.clear();
+        head_ = std::exchange(other.head_, 0);
+        stage_ = std::move(other.stage_);
+        pending_ = std::exchange(other.pending_, 0);
+        return *this;
+    }
+
+
+    inline void OutputQueue::push(const char* data, size_t len, Handle owner) {
+        if (len == 0) return;
+        entries_.push_back(Entry{ data, len, -1, 0, std::move(owner) });
+        pending_ += len;
+    }
+
+    inline void OutputQueue::append(const char* data, size_t len) {
+        if (len == 0) return;
+        if (len > kCoalesceBytes) {
+            // 大块复制一次, 由自己的 string 持有
+            append(std::string(data, len));
+            return;
+        }
+        if (!stage_ || StageBlock::kSize - stage_->used < len) {
+            stage_ = makeShared<StageBlock>();
+        }
+        char* dst = stage_->data + stage_->used;
+        std::memcpy(dst, data, len);
+        stage_->used += len;
+        pending_ += len;
+        // 紧接在队尾段之后时直接延长该段
+        if (!empty()) {
+            Entry& last = entries_.back();
+            if (last.data && last.data + last.len == dst && last.owner == stage_) {
+                last.len += len;
+                return;
+            }
+        }
+        entries_.push_back(Entry{ dst, len, -1, 0, stage_ });
+    }
+
+    inline void OutputQueue::append(std::string_view data, Handle owner) {
+        if (data.size() <= kCoalesceBytes) {
+            append(data.data(), data.size());
+            return;
+        }
+        push(data.data(), data.size(), std::move(owner));
+    }
+
+    inline void OutputQueue::append(Buffer&& buffer) {
+        if (buffer.readableBytes() <= kCoalesceBytes) {
+            append(buffer.peek(), buffer.readableBytes());
+            buffer.retrieveAll();
+            return;
+        }
+        auto owned = makeShared<Buffer>(std::move(buffer));
+        push(owned->peek(), owned->readableBytes(), owned);
+    }
+
+    inline void OutputQueue::append(BufferChain&& chain) {
+        if (chain.readableBytes() <= kCoalesceBytes) {
+            chain.forEachBlock([this](std::string_view block) { append(block.data(), block.size()); });
+            chain.retrieveAll();
+            return;
+        }
+        auto owned = makeShared<BufferChain>(std::move(chain));
+        owned->forEachBlock([&](std::string_view block) { push(block.data(), block.size(), owned); });
+    }
+
+    inline void OutputQueue::append(std::string&& str) {
+        if (str.size() <= kCoalesceBytes) {
+            append(str.data(), str.size());
+            return;
+        }
+        auto owned = makeShared<std::string>(std::move(str));
+        push(owned->data(), owned->size(), owned);
+    }
+
+    inline void OutputQueue::appendFile(int fd, off_t offset, size_t len, Handle owner) {
+        if (len == 0) return;
+        entries_.push_back(Entry{ nullptr, len, fd, offset, std::move(owner) });
+        pending_ += len;
+    }
+
+    inline void OutputQueue::clear() {
+        entries_.clear();
+        head_ = 0;
+        stage_.reset();
+        pending_ = 0;
+    }
+
+    inline void OutputQueue::consume(size_t n) {
+        pending_ -= n;
+        while (n > 0) {
+            Entry& e = entries_[head_];
+            size_t take = std::min(n, e.len);
+            e.len -= take;
+            if (e.data) e.data += take;
+            else e.fileOffset += static_cast<off_t>(take);
+            n -= take;
+            if (e.len == 0) {
+                e.owner.reset();
+                head_++;
+            }
+        }
+        // 发完时清空; 否则已发出的段占到一半以上时整体前移
+        if (empty()) {
+            entries_.clear();
+            head_ = 0;
+        } else if (head_ >= kCompactEntries && head_ * 2 >= entries_.size()) {
+            entries_.erase(entries_.begin(), entries_.begin() + static_cast<ptrdiff_t>(head_));
+            head_ = 0;
+        }
+    }
+
+    inline ssize_t OutputQueue::writeFd(int fd, int* savedErrno) {
+        if (empty()) return 0;
+
+        ssize_t n;
+        Entry& head = entries_[head_];
+        if (!head.data) {
+            off_t offset = head.fileOffset;
+            n = ::sendfile(fd, head.fileFd, &offset, head.len);
+            if (n == 0) {
+                // 文件比登记的区间短
+                *savedErrno = ENODATA;
+                return -1;
+            }
+        } else {
+            struct iovec vecs[kMaxIov];
+            int iovcnt = 0;
+            for (size_t i = head_; i < entries_.size(); i++) {
+                const Entry& e = entries_[i];
+                if (!e.data || iovcnt == kMaxIov) break;
+                vecs[iovcnt].iov_base = const_cast<char*>(e.data);
+                vecs[iovcnt].iov_len = e.len;
+                iovcnt++;
+            }
+            n = ::writev(fd, vecs, iovcnt);
+        }
+        if (n < 0) {
+            *savedErrno = errno;
+            return n;
+        }
+        consume(static_cast<size_t>(n));
+        return n;
+    }
+}
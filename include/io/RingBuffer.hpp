@@ -0,0 +1,221 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <algorithm>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+namespace hspd
+{
+    // ==============================================================
+    //                          RingBuffer
+    //      与 Buffer 接口相同的环形缓冲: 同一个 memfd 的页在地址空间中
+    //      前后映射两次, 越过末尾的读写自动落回开头, 可读与可写区间
+    //      总是连续的, peek() 不需要拼接, 也不会像 Buffer::makeSpace
+    //      那样把数据前移。容量为 2 的幂且至少一页, 写满时翻倍(复制一次)。
+    //      适合长连接的流式收发(日志转发、websocket)
+    // ==============================================================
+    class RingBuffer {
+    public:
+        explicit RingBuffer(size_t initialSize = 64 * 1024);
+        ~RingBuffer();
+
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+        RingBuffer(RingBuffer&& other) noexcept;
+        RingBuffer& operator=(RingBuffer&& other) noexcept;
+
+        void swap(RingBuffer& other) noexcept;
+
+        size_t readableBytes() const { return writeIndex_ - readIndex_; }
+        size_t writableBytes() const { return capacity_ - readableBytes(); }
+        size_t capacity() const { return capacity_; }
+
+        /// 可读数据的起始位置, 之后 readableBytes() 字节连续
+        const char* peek() const { return base_ + (readIndex_ & (capacity_ - 1)); }
+
+        /// 取走 len 字节
+        void retrieve(size_t len);
+        void retrieveAll();
+
+        /// 供 ObjectPool 回收: 清空内容, 容量缩回不超过 kMaxRetainedSize
+        void reset();
+        std::string retrieveAsString(size_t len);
+        std::string retrieveAllAsString();
+
+        /// 添加数据, 空间不足时扩容
+        void append(const char* data, size_t len);
+        void append(std::string_view str) { append(str.data(), str.size()); }
+
+        /// 返回可写起点, 之后 writableBytes() 字节连续
+        char* beginWrite() { return base_ + (writeIndex_ & (capacity_ - 1)); }
+        void hasWritten(size_t len) { writeIndex_ += len; }
+
+        /// 写 socket
+        ssize_t writeFd(int fd, int* savedErrno);
+
+        /// 从 socket 读: 直接读入全部可写区间, 已满时先扩容
+        ssize_t readFd(int fd, int* savedErrno);
+
+    private:
+        static size_t roundCapacity(size_t n);
+        static char* mapMirrored(size_t capacity);
+        static void unmapMirrored(char* base, size_t capacity) noexcept;
+
+        void reallocate(size_t capacity);
+
+    private:
+        char* base_;
+        size_t capacity_;
+        // 单调递增的偏移, 与 capacity_ - 1 相与得到位置
+        uint64_t readIndex_ = 0;
+        uint64_t writeIndex_ = 0;
+        static constexpr size_t kMaxRetainedSize = 64 * 1024;
+    };
+
+
+    inline RingBuffer::RingBuffer(size_t initialSize)
+        : base_(mapMirrored(roundCapacity(initialSize))),
+        capacity_(roundCapacity(initialSize)) {}
+
+    inline RingBuffer::~RingBuffer() {
+        if (base_) unmapMirrored(base_, capacity_);
+    }
+
+    inline RingBuffer::RingBuffer(RingBuffer&& other) noexcept
+        : base_(std::exchange(other.base_, nullptr)),
+        capacity_(std::exchange(other.capacity_, 0)),
+        readIndex_(std::exchange(other.readIndex_, 0)),
+        writeIndex_(std::exchange(other.writeIndex_, 0)) {}
+
+    inline RingBuffer& RingBuffer::operator=(RingBuffer&& other) noexcept {
+        RingBuffer tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    }
+
+    inline void RingBuffer::swap(RingBuffer& other) noexcept {
+        std::swap(base_, other.base_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(readIndex_, other.readIndex_);
+        std::swap(writeIndex_, other.writeIndex_);
+    }
+
+    inline size_t RingBuffer::roundCapacity(size_t n) {
+        size_t cap = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+    // 先保留 2 * capacity 的地址空间, 再把 memfd 以 MAP_FIXED 映射到前后两半
+    inline char* RingBuffer::mapMirrored(size_t capacity) {
+        int fd = ::memfd_create("hspd-ring", MFD_CLOEXEC);
+        if (fd < 0) throw std::system_error(errno, std::system_category(), "memfd_create failed");
+        if (::ftruncate(fd, static_cast<off_t>(capacity)) < 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), "ftruncate failed");
+        }
+        void* area = ::mmap(nullptr, capacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), "mmap failed");
+        }
+        char* base = static_cast<char*>(area);
+        for (char* half : { base, base + capacity }) {
+            if (::mmap(half, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                int err = errno;
+                ::munmap(base, capacity * 2);
+                ::close(fd);
+                throw std::system_error(err, std::system_category(), "mmap failed");
+            }
+        }
+        // 映射持有文件, fd 不再需要
+        ::close(fd);
+        return base;
+    }
+
+    inline void RingBuffer::unmapMirrored(char* base, size_t capacity) noexcept {
+        ::munmap(base, capacity * 2);
+    }
+
+    // 换成新的映射, 可读数据复制到开头
+    inline void RingBuffer::reallocate(size_t capacity) {
+        size_t readable = readableBytes();
+        char* base = mapMirrored(capacity);
+        std::memcpy(base, peek(), readable);
+        unmapMirrored(base_, capacity_);
+        base_ = base;
+        capacity_ = capacity;
+        readIndex_ = 0;
+        writeIndex_ = readable;
+    }
+
+    inline void RingBuffer::retrieve(size_t len) {
+        if (len < readableBytes()) {
+            readIndex_ += len;
+        } else {
+            retrieveAll();
+        }
+    }
+
+    inline void RingBuffer::retrieveAll() {
+        readIndex_ = writeIndex_ = 0;
+    }
+
+    inline void RingBuffer::reset() {
+        retrieveAll();
+        if (capacity_ > kMaxRetainedSize) {
+            reallocate(roundCapacity(kMaxRetainedSize));
+        }
+    }
+
+    inline std::string RingBuffer::retrieveAsString(size_t len) {
+        len = std::min(len, readableBytes());
+        std::string result(peek(), len);
+        retrieve(len);
+        return result;
+    }
+
+    inline std::string RingBuffer::retrieveAllAsString() {
+        return retrieveAsString(readableBytes());
+    }
+
+    inline void RingBuffer::append(const char* data, size_t len) {
+        if (len > writableBytes()) {
+            reallocate(roundCapacity(std::max(readableBytes() + len, capacity_ * 2)));
+        }
+        std::memcpy(beginWrite(), data, len);
+        writeIndex_ += len;
+    }
+
+    inline ssize_t RingBuffer::readFd(int fd, int* savedErrno) {
+        if (writableBytes() == 0) {
+            reallocate(capacity_ * 2);
+        }
+        ssize_t n = ::read(fd, beginWrite(), writableBytes());
+        if (n < 0) {
+            *savedErrno = errno;
+            return n;
+        }
+        writeIndex_ += n;
+        return n;
+    }
+
+    inline ssize_t RingBuffer::writeFd(int fd, int* savedErrno) {
+        ssize_t n = ::write(fd, peek(), readableBytes());
+        if (n < 0) {
+            *savedErrno = errno;
+            return n;
+        }
+        retrieve(n);
+        return n;
+    }
+}
@@ -8,6 +8,10 @@
 #include <stdexcept>
 #include <type_traits>
 #include <vector>
+#include <array>
+#include <tuple>
+#include <memory_resource>
+#include <alloc/Arena.hpp>
 
 namespace hspd {
 
@@ -168,46 +172,49 @@ private:
     }
 };
 
-// 格式化上下文
+// 参数包装器直接存放在调用者的栈上, 不做堆分配
+template<typename... Args>
+class format_arg_store {
+public:
+    explicit format_arg_store(const Args&... args)
+        : args_(args...),
+          ptrs_(std::apply([](const auto&... a) {
+              return std::array<const format_arg_base*, sizeof...(Args)>{ &a... };
+          }, args_)) {}
+
+    format_arg_store(const format_arg_store&) = delete;
+    format_arg_store& operator=(const format_arg_store&) = delete;
+
+    const format_arg_base* const* data() const { return ptrs_.data(); }
+
+private:
+    std::tuple<format_arg<Args>...> args_;
+    std::array<const format_arg_base*, sizeof...(Args)> ptrs_;
+};
+
+// 格式化上下文: 指向一组参数的视图
 class format_context {
 public:
     template<typename... Args>
-    format_context(const Args&... args) {
-        reserve(sizeof...(Args));
-        (emplace_back(args), ...);
-    }
-    
-    ~format_context() {
-        for (auto* arg : args_) {
-            delete arg;
-        }
-    }
+    format_context(const format_arg_store<Args...>& store)
+        : args_(store.data()), size_(sizeof...(Args)) {}
     
     const format_arg_base* get_arg(size_t index) const {
-        if (index >= args_.size()) {
+        if (index >= size_) {
             throw format_error("Argument index out of range");
         }
         return args_[index];
     }
     
-    size_t size() const { return args_.size(); }
+    size_t size() const { return size_; }
 
 private:
-    std::vector<format_arg_base*> args_;
-    
-    void reserve(size_t size) {
-        args_.reserve(size);
-    }
-    
-    template<typename T>
-    void emplace_back(const T& value) {
-        args_.push_back(new format_arg<T>(value));
-    }
+    const format_arg_base* const* args_;
+    size_t size_;
 };
 
-// 解析格式字符串并生成结果
-std::string vformat(std::string_view fmt, const format_context& ctx) {
-    std::ostringstream oss;
+// 解析格式字符串, 结果写入 oss
+inline void vformat_to(std::ostream& oss, std::string_view fmt, const format_context& ctx) {
     size_t pos = 0;
     size_t len = fmt.length();
     size_t arg_index = 0;
@@ -291,17 +298,32 @@ std::string vformat(std::string_view fmt, const format_context& ctx) {
     if (arg_index < ctx.size()) {
         throw format_error("Too many arguments provided");
     }
-    
-    return oss.str();
 }
 
+inline std::string vformat(std::string_view fmt, const format_context& ctx) {
+    std::ostringstream oss;
+    vformat_to(oss, fmt, ctx);
+    return std::move(oss).str();
+}
+
+using arena_ostringstream = std::basic_ostringstream<char, std::char_traits<char>, std::pmr::polymorphic_allocator<char>>;
+
 } // namespace detail
 
 // 主格式化函数
 template<typename... Args>
 std::string format(std::string_view fmt, const Args&... args) {
-    detail::format_context ctx(args...);
-    return detail::vformat(fmt, ctx);
+    detail::format_arg_store<Args...> store(args...);
+    return detail::vformat(fmt, detail::format_context(store));
+}
+
+// 结果和中间缓冲都分配在 arena 中, 随 arena.reset() 一起回收
+template<typename... Args>
+std::pmr::string format(Arena& arena, std::string_view fmt, const Args&... args) {
+    detail::format_arg_store<Args...> store(args...);
+    detail::arena_ostringstream oss(std::ios_base::out, std::pmr::polymorphic_allocator<char>(&arena));
+    detail::vformat_to(oss, fmt, detail::format_context(store));
+    return std::move(oss).str();
 }
 
 } // namespace my
@@ -22,6 +22,8 @@ public:
     using Scheduler_t = ThreadPool;
     using EventLoop_t = Epoll;
 
+    // 每个 fd 一个 Waiter; 派发后只清空, 不删除节点, 同一连接反复等待时不再分配哈希表节点,
+    // fd 移除时才真正删除
     struct Waiter {
         std::coroutine_handle<> handle = nullptr;
         uint32_t events = 0;
@@ -115,7 +117,7 @@ public:
                 {
                         // 找到对应 waiter，交给线程池去 resume()
                     auto it = waiters_.find(fd);
-                    if (it == waiters_.end()) {
+                    if (it == waiters_.end() || !it->second.handle) {
                         // 未找到 waiter：可能是race或已被移除，记录并 continue
                         // 可能存在空转的可能, 但不影响正确性, async_read并不是依赖于Epoll模型
                         // async_read首先在线程池中进行调度
@@ -123,8 +125,7 @@ public:
                         continue;
                     }
 
-                    waiter = it->second;
-                    waiters_.erase(it);
+                    waiter = std::exchange(it->second, Waiter{});
                 }
 
                 // 派发到线程池恢复协程（resume 需要在 worker 线程执行）
@@ -174,7 +175,8 @@ private:
     Scheduler_t* executor_;
     EventLoop_t* ev_;
     std::atomic_bool running_;
-    std::unordered_map<int, Waiter> waiters_;
+    std::unordered_map<int, Waiter, std::hash<int>, std::equal_to<int>,
+                       PoolAllocator<std::pair<const int, Waiter>>> waiters_;
     struct epoll_event events_[EVENTS_MAX];
 
 };
@@ -10,6 +10,10 @@
 #include <sys/socket.h>
 
 #include <io/Buffer.hpp>
+#include <io/BufferChain.hpp>
+#include <io/RingBuffer.hpp>
+#include <io/OutputQueue.hpp>
+#include <alloc/ObjectPool.hpp>
 #include <Coro/Awaitable.hpp>
 #include <net/Epoll.hpp>
 #include <net/IOContext.hpp>
@@ -59,6 +63,8 @@ public:
 
     // 协程式 accept（事件驱动）
     inline Awaitable<Socket> async_accept();
+    // 同上, 但 Socket 对象取自对象池, 连接频繁建立/断开时复用
+    inline Awaitable<ObjectPool<Socket>::Ptr> async_accept(ObjectPool<Socket>& pool);
 
     void close() {
         if (listenfd_ >= 0) {
@@ -95,12 +101,13 @@ public:
 
     Socket(const Socket&) = delete;
     Socket& operator=(const Socket&) = delete;
-    Socket(Socket&& o) noexcept : sockfd_(o.sockfd_), ctx_(o.ctx_) { o.sockfd_ = -1; o.ctx_ = nullptr; }
+    Socket(Socket&& o) noexcept : sockfd_(o.sockfd_), ctx_(o.ctx_), output_(std::move(o.output_)) { o.sockfd_ = -1; o.ctx_ = nullptr; }
     Socket& operator=(Socket&& o) noexcept {
         if (this != &o) {
             close();
             sockfd_ = o.sockfd_;
             ctx_ = o.ctx_;
+            output_ = std::move(o.output_);
             o.sockfd_ = -1;
             o.ctx_ = nullptr;
         }
@@ -109,8 +116,23 @@ public:
 
     int fd() const noexcept { return sockfd_; }
 
+    // 供 ObjectPool 回收与复用
+    void reset() {
+        close();
+        output_.clear();
+    }
+    void reset(int fd, IOContext* ctx) {
+        close();
+        output_.clear();
+        sockfd_ = fd;
+        ctx_ = ctx;
+        if (sockfd_ >= 0) ctx_->add_fd(sockfd_, EPOLLIN);
+    }
+
     // 协程读：立刻尝试 readFd，EAGAIN 则 co_await ctx_->await_fd(fd, EPOLLIN)
-    Awaitable<size_t> async_read(Buffer& buffer) {
+    // BufferT 为 Buffer、BufferChain 或 RingBuffer
+    template <typename BufferT>
+    Awaitable<size_t> async_read(BufferT& buffer) {
         while (true) {
             // 当dispatch调度我的时候, 我直接开始读, 直接将内容全部读完
             int saveErr = 0;
@@ -138,7 +160,8 @@ public:
         }
     }
 
-    Awaitable<size_t> async_write(Buffer& buffer) {
+    template <typename BufferT>
+    Awaitable<size_t> async_write(BufferT& buffer) {
         while (true) {
             // 做一个特殊的判断
             if(buffer.readableBytes() == 0)
@@ -163,6 +186,32 @@ public:
         }
     }
 
+    // 待发送队列: 一轮处理中产生的响应先 append 进来, 再用一次 async_flush 发出
+    OutputQueue& output() noexcept { return output_; }
+
+    // 发送队列中的全部数据, 每次尽量用一个 writev; 返回发送的字节数
+    Awaitable<size_t> async_flush() {
+        size_t total = 0;
+        while (!output_.empty()) {
+            int saveErr = 0;
+            auto n = output_.writeFd(sockfd_, &saveErr);
+            if (n >= 0) {
+                total += static_cast<size_t>(n);
+                continue;
+            }
+
+            if (saveErr == EAGAIN || saveErr == EWOULDBLOCK) {
+                uint32_t modify_events = ctx_->get_events(sockfd_) | EPOLLOUT;
+                co_await ctx_->await_fd(sockfd_, modify_events);
+                continue;
+            }
+
+            throw std::system_error(saveErr, std::system_category(), "write failed");
+        }
+        LOG_INFO("{} async_flush : {} bytes", sockfd_, total);
+        co_return total;
+    }
+
     void close() {
         if (sockfd_ >= 0) {
             if (ctx_) ctx_->remove_fd(sockfd_);
@@ -174,6 +223,7 @@ public:
 private:
     int sockfd_ = -1;
     IOContext* ctx_ = nullptr;
+    OutputQueue output_;
 };
 
 // ---------------- Acceptor::async_accept 定义 ----------------
@@ -196,6 +246,21 @@ inline Awaitable<Socket> Acceptor::async_accept()
     }
 }
 
+inline Awaitable<ObjectPool<Socket>::Ptr> Acceptor::async_accept(ObjectPool<Socket>& pool)
+{
+    while (true) {
+        int cfd = ::accept4(listenfd_, nullptr, nullptr, SOCK_NONBLOCK);
+        if (cfd >= 0) {
+            co_return pool.acquire(cfd, ctx_);
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            co_await ctx_->await_fd(listenfd_, EPOLLIN);
+            continue;
+        }
+        throw std::system_error(errno, std::system_category(), "accept failed");
+    }
+}
+
 } // namespace hspd
 
 #endif // SOCKET_HPP
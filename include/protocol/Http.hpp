@@ -3,10 +3,12 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <memory_resource>
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
 #include <cctype>
+#include <alloc/PoolAllocator.hpp>
 
 namespace hspd {
 
@@ -30,8 +32,14 @@ enum class HttpVersion {
     UNKNOWN
 };
 
+// 字符串与 headers 都从构造时给定的 memory_resource 分配, 默认是全局内存池;
+// 传入一个 Arena 即可让一次请求的解析结果全部落在 arena 中
 class HttpMessage : public Message {
 public:
+    using Headers = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
+    explicit HttpMessage(std::pmr::memory_resource* mr = PoolResource::instance())
+        : url_(mr), headers_(mr), body_(mr) {}
     virtual ~HttpMessage() = default;
 
     std::string serialize_to_string() const override;
@@ -40,27 +48,37 @@ public:
 
     const HttpMethod& method() const { return method_; }
     const HttpVersion& version() const { return version_; }
-    const std::string& url() const { return url_; }
-    const std::unordered_map<std::string, std::string>& headers() const { return headers_; }
-    const std::string& body() const { return body_; }
+    const std::pmr::string& url() const { return url_; }
+    const Headers& headers() const { return headers_; }
+    const std::pmr::string& body() const { return body_; }
 
     void set_method(const HttpMethod& method) { method_ = method; }
     void set_version(const HttpVersion& version) { version_ = version; }
-    void set_url(const std::string& url) { url_ = url; }
-    void set_headers(const std::unordered_map<std::string, std::string>& headers) { headers_ = headers; }
-    void set_body(const std::string& body) { body_ = body; }
-    void add_header(const std::string& key, const std::string& value) { headers_[key] = value; }
+    void set_url(std::string_view url) { url_.assign(url); }
+    void set_headers(const Headers& headers) { headers_ = headers; }
+    void set_body(std::string_view body) { body_.assign(body); }
+    // 供 ObjectPool 回收: 清空内容, 保留字符串与 headers 的容量
+    void reset() {
+        method_ = HttpMethod::UNKNOWN;
+        version_ = HttpVersion::UNKNOWN;
+        url_.clear();
+        headers_.clear();
+        body_.clear();
+    }
+    void add_header(std::string_view key, std::string_view value) {
+        headers_.insert_or_assign(std::pmr::string(key, headers_.get_allocator()), value);
+    }
 
-    static HttpMethod parse_method(const std::string& s);
-    static HttpVersion parse_version(const std::string& s);
+    static HttpMethod parse_method(std::string_view s);
+    static HttpVersion parse_version(std::string_view s);
     static std::string version_to_str(HttpVersion v);
     static std::string method_to_str(HttpMethod m);
 private:
     HttpMethod method_;
     HttpVersion version_;
-    std::string url_;
-    std::unordered_map<std::string, std::string> headers_;
-    std::string body_;
+    std::pmr::string url_;
+    Headers headers_;
+    std::pmr::string body_;
 
     
 
@@ -69,7 +87,7 @@ private:
 };
 
 
-HttpMethod HttpMessage::parse_method(const std::string& s)
+HttpMethod HttpMessage::parse_method(std::string_view s)
 {
     if (s == "GET") return HttpMethod::GET;
     if (s == "POST") return HttpMethod::POST;
@@ -84,7 +102,7 @@ HttpMethod HttpMessage::parse_method(const std::string& s)
     return HttpMethod::UNKNOWN;
 }
 
-HttpVersion HttpMessage::parse_version(const std::string& s)
+HttpVersion HttpMessage::parse_version(std::string_view s)
 {
     if (s == "HTTP/1.0") return HttpVersion::HTTP_1_0;
     if (s == "HTTP/1.1") return HttpVersion::HTTP_1_1;
@@ -149,57 +167,64 @@ bool HttpMessage::parse_from_string(const std::string& str)
     return parse_from_string(str.c_str(), str.size());
 }
 
+// 全程只在输入上做 string_view 切片, 只有写入成员的字符串会分配内存
 bool HttpMessage::parse_from_string(const char* str, size_t len)
 {
-    std::string data(str, len);
+    std::string_view data(str, len);
 
     size_t pos = data.find(line_sep);
-    if (pos == std::string::npos)
+    if (pos == std::string_view::npos)
         return false;
 
     //========== 1. 解析起始行 ==========
-    std::string start_line = data.substr(0, pos);
-
     {
-        std::istringstream ss(start_line);
-        std::string method_s, url_s, version_s;
-
-        ss >> method_s >> url_s >> version_s;
-
-        method_ = parse_method(method_s);
-        url_ = url_s;
-        version_ = parse_version(version_s);
+        std::string_view start_line = data.substr(0, pos);
+        auto next_token = [&start_line]() {
+            size_t b = start_line.find_first_not_of(' ');
+            if (b == std::string_view::npos) return std::string_view();
+            size_t e = start_line.find(' ', b);
+            std::string_view tok = start_line.substr(b, e == std::string_view::npos ? std::string_view::npos : e - b);
+            start_line.remove_prefix(b + tok.size());
+            return tok;
+        };
+
+        method_ = parse_method(next_token());
+        url_.assign(next_token());
+        version_ = parse_version(next_token());
     }
 
     //========== 2. 解析 headers ==========
     size_t header_start = pos + line_sep.size();
-    size_t header_end = data.find("\r\n\r\n");
+    size_t header_end = data.find("\r\n\r\n", pos);
 
-    if (header_end == std::string::npos)
+    if (header_end == std::string_view::npos)
         return false;
 
     headers_.clear();
 
-    std::string header_block = data.substr(header_start, header_end - header_start);
+    std::string_view header_block = header_start < header_end
+        ? data.substr(header_start, header_end - header_start)
+        : std::string_view();
 
-    std::istringstream hs(header_block);
-    std::string line;
-    while (std::getline(hs, line)) {
+    while (!header_block.empty()) {
+        size_t eol = header_block.find('\n');
+        std::string_view line = header_block.substr(0, eol);
+        header_block.remove_prefix(eol == std::string_view::npos ? header_block.size() : eol + 1);
         if (!line.empty() && line.back() == '\r')
-            line.pop_back();
+            line.remove_suffix(1);
 
-        size_t colon = line.find(":");
-        if (colon == std::string::npos) continue;
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) continue;
 
-        std::string key = line.substr(0, colon);
-        std::string value = line.substr(colon + 1);
-        value.erase(0, value.find_first_not_of(" "));
+        std::string_view value = line.substr(colon + 1);
+        size_t first = value.find_first_not_of(' ');
+        value.remove_prefix(first == std::string_view::npos ? value.size() : first);
 
-        headers_[key] = value;
+        add_header(line.substr(0, colon), value);
     }
 
     //========== 3. 解析 body ==========
-    body_ = data.substr(header_end + line_sep.size() * 2);
+    body_.assign(data.substr(header_end + line_sep.size() * 2));
 
     return true;
 }
@@ -2,13 +2,18 @@
 #define JSON_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <memory_resource>
+#include <charconv>
 #include <stdexcept>
 #include <cctype>
 #include <sstream>
 #include <utility>
 #include <iostream>
+#include <alloc/PoolAllocator.hpp>
+#include <alloc/Arena.hpp>
 
 namespace hspd {
 
@@ -21,9 +26,24 @@ enum class JsonType {
     Null
 };
 
+class JsonBase;
 class JsonObject;
 class JsonArray;
 
+// 节点可能来自堆, 也可能由 JsonParser 建在 Arena 里; 后者只析构不释放
+struct JsonDeleter {
+    bool arenaOwned = false;
+
+    JsonDeleter() = default;
+    explicit JsonDeleter(bool arena) : arenaOwned(arena) {}
+    template <typename U>
+    JsonDeleter(const std::default_delete<U>&) {}
+
+    void operator()(JsonBase* p) const;
+};
+
+using JsonPtr = std::unique_ptr<JsonBase, JsonDeleter>;
+
 // ------------------------- JsonBase -------------------------
 class JsonBase {
 public:
@@ -40,10 +60,16 @@ public:
     virtual bool asBool() { throw std::runtime_error("Not a boolean"); }
 };
 
+inline void JsonDeleter::operator()(JsonBase* p) const {
+    if (arenaOwned) p->~JsonBase();
+    else delete p;
+}
+
 // ------------------------- JsonString -------------------------
 class JsonString : public JsonBase {
 public:
-    explicit JsonString(std::string v) : value_(std::move(v)) {}
+    explicit JsonString(std::string_view v, std::pmr::memory_resource* mr = PoolResource::instance())
+        : value_(v, mr) {}
     JsonType getType() const override { return JsonType::String; }
     std::string toString() const override {
         std::string out = "\"";
@@ -61,10 +87,11 @@ public:
         return out;
     }
     std::string dump(int indent, int depth) const override { return toString(); }
-    std::string asString() override { return value_; }
-    const std::string& getValue() const { return value_; }
+    std::string asString() override { return std::string(value_); }
+    const std::pmr::string& getValue() const { return value_; }
 private:
-    std::string value_;
+    std::pmr::string value_;
+    friend class JsonParser;
 };
 
 // ------------------------- JsonNumber -------------------------
@@ -108,10 +135,11 @@ public:
 // ------------------------- JsonObject -------------------------
 class JsonObject : public JsonBase {
 public:
-    using Member = std::pair<std::string, std::unique_ptr<JsonBase>>;
-    using Members = std::vector<Member>;
+    using Member = std::pair<std::pmr::string, JsonPtr>;
+    using Members = std::pmr::vector<Member>;
 
-    JsonObject() = default;
+    JsonObject() : members_(PoolResource::instance()) {}
+    explicit JsonObject(std::pmr::memory_resource* mr) : members_(mr) {}
     explicit JsonObject(Members m) : members_(std::move(m)) {}
 
     JsonType getType() const override { return JsonType::Object; }
@@ -119,13 +147,13 @@ public:
 
     const Members& getMembers() const { return members_; }
 
-    bool contains(const std::string& key) const {
+    bool contains(std::string_view key) const {
         for (const auto& m : members_) if (m.first == key) return true;
         return false;
     }
 
     // return reference to underlying unique_ptr for JsonValue to hold
-    std::unique_ptr<JsonBase>& getRefForKeyCreate(const std::string& key) {
+    JsonPtr& getRefForKeyCreate(std::string_view key) {
         for (auto& m : members_) {
             if (m.first == key) return m.second;
         }
@@ -134,23 +162,26 @@ public:
     }
 
     // const access
-    const JsonBase& operator[](const std::string& key) const {
+    const JsonBase& operator[](std::string_view key) const {
         for (const auto& m : members_) if (m.first == key) return *m.second;
-        throw std::runtime_error("Key not found: " + key);
+        throw std::runtime_error("Key not found: " + std::string(key));
     }
 
     // insert (alias add)
-    void insert(std::string key, std::unique_ptr<JsonBase> val) {
-        members_.emplace_back(std::move(key), std::move(val));
+    void insert(std::string_view key, JsonPtr val) {
+        members_.emplace_back(key, std::move(val));
     }
-    void add(std::string key, std::unique_ptr<JsonBase> val) { insert(std::move(key), std::move(val)); }
+    void add(std::string_view key, JsonPtr val) { insert(key, std::move(val)); }
 
     std::string toString() const override {
         std::string result = "{";
         bool first = true;
         for (const auto& m : members_) {
             if (!first) result += ",";
-            result += "\"" + m.first + "\":" + m.second->toString();
+            result += '"';
+            result += m.first;
+            result += "\":";
+            result += m.second->toString();
             first = false;
         }
         result += "}";
@@ -163,7 +194,11 @@ public:
         std::string inside((depth + 1) * indent, ' ');
         std::string res = "{\n";
         for (size_t i = 0; i < members_.size(); ++i) {
-            res += inside + "\"" + members_[i].first + "\": " + members_[i].second->dump(indent, depth + 1);
+            res += inside;
+            res += '"';
+            res += members_[i].first;
+            res += "\": ";
+            res += members_[i].second->dump(indent, depth + 1);
             if (i + 1 < members_.size()) res += ",";
             res += "\n";
         }
@@ -179,8 +214,9 @@ private:
 // ------------------------- JsonArray -------------------------
 class JsonArray : public JsonBase {
 public:
-    using Elements = std::vector<std::unique_ptr<JsonBase>>;
-    JsonArray() = default;
+    using Elements = std::pmr::vector<JsonPtr>;
+    JsonArray() : elements_(PoolResource::instance()) {}
+    explicit JsonArray(std::pmr::memory_resource* mr) : elements_(mr) {}
     explicit JsonArray(Elements e) : elements_(std::move(e)) {}
 
     JsonType getType() const override { return JsonType::Array; }
@@ -189,7 +225,7 @@ public:
     const Elements& getElements() const { return elements_; }
 
     // return reference to element's unique_ptr (for JsonValue)
-    std::unique_ptr<JsonBase>& getElementRefCreate(size_t idx) {
+    JsonPtr& getElementRefCreate(size_t idx) {
         if (idx >= elements_.size()) {
             // expand and fill with nulls
             elements_.resize(idx + 1);
@@ -231,7 +267,7 @@ public:
         return res;
     }
 
-    void push(std::unique_ptr<JsonBase> v) { elements_.push_back(std::move(v)); }
+    void push(JsonPtr v) { elements_.push_back(std::move(v)); }
 
     size_t size() const { return elements_.size(); }
 
@@ -243,8 +279,8 @@ private:
 // ------------------------- JsonValue (代理) -------------------------
 class JsonValue {
 public:
-    // construct from pointer to owning unique_ptr<JsonBase>
-    explicit JsonValue(std::unique_ptr<JsonBase>* ref_ptr) : ref_ptr_(ref_ptr) {
+    // construct from pointer to owning JsonPtr
+    explicit JsonValue(JsonPtr* ref_ptr) : ref_ptr_(ref_ptr) {
         if (!ref_ptr_) throw std::runtime_error("Null reference in JsonValue");
         if (!*ref_ptr_) {
             // initialize with null if unset
@@ -252,7 +288,7 @@ public:
         }
     }
     // 自己私有一个对象直接构造
-    explicit JsonValue() : ref_ptr_(new std::unique_ptr<JsonBase>(new JsonObject())) {}
+    explicit JsonValue() : ref_ptr_(new JsonPtr(new JsonObject())) {}
 
     // Copyable (pointer semantics)
     JsonValue(const JsonValue& other) = default;
@@ -278,8 +314,8 @@ public:
         *ref_ptr_ = std::make_unique<JsonArray>(std::move(arr));
         return *this;
     }
-    // assign from unique_ptr<JsonBase>
-    JsonValue& operator=(std::unique_ptr<JsonBase> up) {
+    // assign from JsonPtr
+    JsonValue& operator=(JsonPtr up) {
         *ref_ptr_ = std::move(up);
         if (!*ref_ptr_) *ref_ptr_ = std::make_unique<JsonNull>();
         return *this;
@@ -344,7 +380,7 @@ public:
     void push(double d) { ensureArray(); asArray().push(std::make_unique<JsonNumber>(d)); }
     void push(int i) { ensureArray(); asArray().push(std::make_unique<JsonNumber>(static_cast<double>(i))); }
     void push(bool b) { ensureArray(); asArray().push(std::make_unique<JsonBoolean>(b)); }
-    void push(std::unique_ptr<JsonBase> v) { ensureArray(); asArray().push(std::move(v)); }
+    void push(JsonPtr v) { ensureArray(); asArray().push(std::move(v)); }
 
     // stringify / dump
     std::string toString() const {
@@ -357,7 +393,7 @@ public:
     }
 
 private:
-    std::unique_ptr<JsonBase>* ref_ptr_{nullptr};
+    JsonPtr* ref_ptr_{nullptr};
 
     // internal helpers
     JsonValue& assignString(const std::string& s) {
@@ -393,108 +429,147 @@ private:
 };
 
 // ------------------------- JSON Parser -------------------------
+// parse(json) 在堆上建立 DOM; parse(json, arena) 把节点、字符串和容器全部建在 arena 里,
+// 返回的树必须先于 arena.reset() 销毁
 class JsonParser {
 public:
-    static std::unique_ptr<JsonBase> parse(const std::string& json) {
-        size_t pos = 0;
-        skipSpaces(json, pos);
-        auto root = parseValue(json, pos);
-        skipSpaces(json, pos);
+    static JsonPtr parse(std::string_view json) {
+        Context ctx{ json, 0, PoolResource::instance(), nullptr };
+        return parseRoot(ctx);
+    }
+
+    static JsonPtr parse(std::string_view json, Arena& arena) {
+        Context ctx{ json, 0, &arena, &arena };
+        return parseRoot(ctx);
+    }
+
+private:
+    struct Context {
+        std::string_view json;
+        size_t pos;
+        std::pmr::memory_resource* mr;  // 字符串与容器使用的内存
+        Arena* arena;                   // 非空时节点本身也分配在 arena 中
+    };
+
+    template <typename T, typename... Args>
+    static JsonPtr make(Context& ctx, Args&&... args) {
+        if (ctx.arena) return JsonPtr(ctx.arena->create<T>(std::forward<Args>(args)...), JsonDeleter(true));
+        return JsonPtr(new T(std::forward<Args>(args)...));
+    }
+
+    static JsonPtr parseRoot(Context& ctx) {
+        skipSpaces(ctx);
+        auto root = parseValue(ctx);
+        skipSpaces(ctx);
         // accept trailing spaces only
-        if (pos != json.size()) throw std::runtime_error("Extra characters after JSON end");
+        if (ctx.pos != ctx.json.size()) throw std::runtime_error("Extra characters after JSON end");
         return root;
     }
 
-private:
-    static void skipSpaces(const std::string& s, size_t& pos) {
-        while (pos < s.size() && static_cast<unsigned char>(s[pos]) && isspace(static_cast<unsigned char>(s[pos]))) ++pos;
+    static void skipSpaces(Context& ctx) {
+        const auto& s = ctx.json;
+        while (ctx.pos < s.size() && static_cast<unsigned char>(s[ctx.pos]) && isspace(static_cast<unsigned char>(s[ctx.pos]))) ++ctx.pos;
     }
 
-    static std::unique_ptr<JsonBase> parseValue(const std::string& json, size_t& pos) {
-        skipSpaces(json, pos);
-        if (pos >= json.size()) throw std::runtime_error("Unexpected end of JSON");
-        char c = json[pos];
-        if (c == '{') return parseObject(json, pos);
-        if (c == '[') return parseArray(json, pos);
-        if (c == '"') return parseString(json, pos);
-        if (c == 't' || c == 'f') return parseBoolean(json, pos);
-        if (c == 'n') return parseNull(json, pos);
-        if (c == '-' || isdigit(static_cast<unsigned char>(c))) return parseNumber(json, pos);
-        throw std::runtime_error(std::string("Invalid JSON value at pos ") + std::to_string(pos));
+    static JsonPtr parseValue(Context& ctx) {
+        skipSpaces(ctx);
+        if (ctx.pos >= ctx.json.size()) throw std::runtime_error("Unexpected end of JSON");
+        char c = ctx.json[ctx.pos];
+        if (c == '{') return parseObject(ctx);
+        if (c == '[') return parseArray(ctx);
+        if (c == '"') return parseString(ctx);
+        if (c == 't' || c == 'f') return parseBoolean(ctx);
+        if (c == 'n') return parseNull(ctx);
+        if (c == '-' || isdigit(static_cast<unsigned char>(c))) return parseNumber(ctx);
+        throw std::runtime_error(std::string("Invalid JSON value at pos ") + std::to_string(ctx.pos));
     }
 
-    static std::unique_ptr<JsonBase> parseObject(const std::string& json, size_t& pos) {
+    static JsonPtr parseObject(Context& ctx) {
+        const auto& json = ctx.json;
+        auto& pos = ctx.pos;
         ++pos; // skip '{'
-        skipSpaces(json, pos);
-        JsonObject::Members members;
-        if (pos < json.size() && json[pos] == '}') { ++pos; return std::make_unique<JsonObject>(std::move(members)); }
+        skipSpaces(ctx);
+        JsonObject::Members members(ctx.mr);
+        if (pos < json.size() && json[pos] == '}') { ++pos; return make<JsonObject>(ctx, std::move(members)); }
         while (true) {
-            skipSpaces(json, pos);
+            skipSpaces(ctx);
             if (pos >= json.size() || json[pos] != '"') throw std::runtime_error("Expected string key in object");
-            auto keyNode = parseString(json, pos);
-            std::string key = keyNode->asString();
-            skipSpaces(json, pos);
+            std::pmr::string key(ctx.mr);
+            parseStringInto(ctx, key);
+            skipSpaces(ctx);
             if (pos >= json.size() || json[pos] != ':') throw std::runtime_error("Expected ':' after key");
             ++pos;
-            skipSpaces(json, pos);
-            auto val = parseValue(json, pos);
+            skipSpaces(ctx);
+            auto val = parseValue(ctx);
             members.emplace_back(std::move(key), std::move(val));
-            skipSpaces(json, pos);
+            skipSpaces(ctx);
             if (pos >= json.size()) throw std::runtime_error("Unexpected end in object");
             if (json[pos] == '}') { ++pos; break; }
             if (json[pos] == ',') { ++pos; continue; }
             throw std::runtime_error("Expected ',' or '}' in object");
         }
-        return std::make_unique<JsonObject>(std::move(members));
+        return make<JsonObject>(ctx, std::move(members));
     }
 
-    static std::unique_ptr<JsonBase> parseArray(const std::string& json, size_t& pos) {
+    static JsonPtr parseArray(Context& ctx) {
+        const auto& json = ctx.json;
+        auto& pos = ctx.pos;
         ++pos; // skip '['
-        skipSpaces(json, pos);
-        JsonArray::Elements elems;
-        if (pos < json.size() && json[pos] == ']') { ++pos; return std::make_unique<JsonArray>(std::move(elems)); }
+        skipSpaces(ctx);
+        JsonArray::Elements elems(ctx.mr);
+        if (pos < json.size() && json[pos] == ']') { ++pos; return make<JsonArray>(ctx, std::move(elems)); }
         while (true) {
-            skipSpaces(json, pos);
-            auto v = parseValue(json, pos);
+            skipSpaces(ctx);
+            auto v = parseValue(ctx);
             elems.push_back(std::move(v));
-            skipSpaces(json, pos);
+            skipSpaces(ctx);
             if (pos >= json.size()) throw std::runtime_error("Unexpected end in array");
             if (json[pos] == ']') { ++pos; break; }
             if (json[pos] == ',') { ++pos; continue; }
             throw std::runtime_error("Expected ',' or ']' in array");
         }
-        return std::make_unique<JsonArray>(std::move(elems));
+        return make<JsonArray>(ctx, std::move(elems));
+    }
+
+    static JsonPtr parseString(Context& ctx) {
+        auto node = make<JsonString>(ctx, std::string_view(), ctx.mr);
+        parseStringInto(ctx, static_cast<JsonString*>(node.get())->value_);
+        return node;
     }
 
-    static std::unique_ptr<JsonBase> parseString(const std::string& json, size_t& pos) {
+    static void parseStringInto(Context& ctx, std::pmr::string& out) {
+        const auto& json = ctx.json;
+        auto& pos = ctx.pos;
         ++pos; // skip '"'
-        std::string out;
         while (pos < json.size()) {
+            // 没有转义的一段整体追加
+            size_t stop = json.find_first_of("\"\\", pos);
+            if (stop == std::string_view::npos) stop = json.size();
+            out.append(json.data() + pos, stop - pos);
+            pos = stop;
+            if (pos >= json.size()) break;
             char c = json[pos++];
             if (c == '"') break;
-            if (c == '\\') {
-                if (pos >= json.size()) throw std::runtime_error("Bad escape in string");
-                char esc = json[pos++];
-                switch (esc) {
-                    case '"': out.push_back('"'); break;
-                    case '\\': out.push_back('\\'); break;
-                    case '/': out.push_back('/'); break;
-                    case 'b': out.push_back('\b'); break;
-                    case 'f': out.push_back('\f'); break;
-                    case 'n': out.push_back('\n'); break;
-                    case 'r': out.push_back('\r'); break;
-                    case 't': out.push_back('\t'); break;
-                    // unicode \uXXXX not fully supported here
-                    default: out.push_back(esc); break;
-                }
-            } else {
-                out.push_back(c);
+            if (pos >= json.size()) throw std::runtime_error("Bad escape in string");
+            char esc = json[pos++];
+            switch (esc) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                // unicode \uXXXX not fully supported here
+                default: out.push_back(esc); break;
             }
         }
-        return std::make_unique<JsonString>(std::move(out));
     }
 
-    static std::unique_ptr<JsonBase> parseNumber(const std::string& json, size_t& pos) {
+    static JsonPtr parseNumber(Context& ctx) {
+        const auto& json = ctx.json;
+        auto& pos = ctx.pos;
         size_t start = pos;
         if (json[pos] == '-') ++pos;
         while (pos < json.size() && isdigit(static_cast<unsigned char>(json[pos]))) ++pos;
@@ -509,22 +584,21 @@ private:
             while (pos < json.size() && isdigit(static_cast<unsigned char>(json[pos]))) ++pos;
         }
         double val = 0.0;
-        try {
-            val = std::stod(json.substr(start, pos - start));
-        } catch (...) {
+        if (std::from_chars(json.data() + start, json.data() + pos, val).ec != std::errc()) {
             throw std::runtime_error("Invalid number");
         }
-        return std::make_unique<JsonNumber>(val);
+        return make<JsonNumber>(ctx, val);
     }
 
-    static std::unique_ptr<JsonBase> parseBoolean(const std::string& json, size_t& pos) {
-        if (json.compare(pos, 4, "true") == 0) { pos += 4; return std::make_unique<JsonBoolean>(true); }
-        if (json.compare(pos, 5, "false") == 0) { pos += 5; return std::make_unique<JsonBoolean>(false); }
+    static JsonPtr parseBoolean(Context& ctx) {
+        std::string_view rest = ctx.json.substr(ctx.pos);
+        if (rest.starts_with("true")) { ctx.pos += 4; return make<JsonBoolean>(ctx, true); }
+        if (rest.starts_with("false")) { ctx.pos += 5; return make<JsonBoolean>(ctx, false); }
         throw std::runtime_error("Invalid boolean");
     }
 
-    static std::unique_ptr<JsonBase> parseNull(const std::string& json, size_t& pos) {
-        if (json.compare(pos, 4, "null") == 0) { pos += 4; return std::make_unique<JsonNull>(); }
+    static JsonPtr parseNull(Context& ctx) {
+        if (ctx.json.substr(ctx.pos).starts_with("null")) { ctx.pos += 4; return make<JsonNull>(ctx); }
         throw std::runtime_error("Invalid null");
     }
 };
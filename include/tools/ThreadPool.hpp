@@ -4,6 +4,7 @@
 // 这是一个支持future返回值的线程池
 
 #include <queue>
+#include <deque>
 #include <iostream>
 #include <thread>
 #include <mutex>
@@ -15,6 +16,7 @@
 #include <type_traits>
 #include <memory>
 #include <alloc/alloc.hpp>
+#include <alloc/PoolAllocator.hpp>
 #include <log/Log.hpp>
 
 namespace hspd {
@@ -75,7 +77,7 @@ private:
     // 条件变量
     std::condition_variable cv_;
     // 任务队列
-    std::queue<task_t> task_queue_;
+    std::queue<task_t, std::deque<task_t, PoolAllocator<task_t>>> task_queue_;
     // 定义线程池
     std::vector<std::thread> threads_;
     // 等待线程的数量
@@ -0,0 +1,174 @@
+// ==============================================================
+//                       MallocOverride
+//      用 GlobalPoolManager 替换 malloc/free 系列函数与全局 operator new/delete。
+//      编译为 libhspd_malloc.a / libhspd_malloc.so:
+//          链接静态库, 或 LD_PRELOAD=libhspd_malloc.so ./app
+//      池内部的元数据全部来自 mmap, 不会递归调用 malloc
+// ==============================================================
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#include <unistd.h>
+#include <alloc/MemoryPool.hpp>
+
+namespace {
+
+    // malloc 与默认的 operator new 需要 16 字节对齐; 8 字节以内的请求只能放下不需要对齐的对象,
+    // 超过 MAX_POOL_SIZE 的由 PageHeap 按页对齐
+    constexpr size_t kDefaultAlign = 16;
+
+    inline size_t defaultSize(size_t size) {
+        if (size <= ALIGN || size > MAX_POOL_SIZE) return size;
+        return (size + kDefaultAlign - 1) & ~(kDefaultAlign - 1);
+    }
+
+    inline void* allocateDefault(size_t size) {
+        return GlobalPoolManager::instance().allocate(defaultSize(size));
+    }
+
+    inline void* allocateAligned(size_t size, size_t align) {
+        if (align <= kDefaultAlign) return allocateDefault(size);
+        return GlobalPoolManager::instance().allocateAligned(size, align);
+    }
+
+    inline void* mallocNoThrow(size_t size) noexcept {
+        try {
+            return allocateDefault(size);
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return nullptr;
+        }
+    }
+
+    inline void* memalignNoThrow(size_t align, size_t size) noexcept {
+        if (align == 0 || (align & (align - 1)) != 0) {
+            errno = EINVAL;
+            return nullptr;
+        }
+        if (size > PTRDIFF_MAX - align) {
+            errno = ENOMEM;
+            return nullptr;
+        }
+        try {
+            return allocateAligned(size, align);
+        } catch (const std::bad_alloc&) {
+            errno = ENOMEM;
+            return nullptr;
+        }
+    }
+
+    inline void deallocate(void* p) noexcept {
+        if (p) GlobalPoolManager::instance().deallocate(p);
+    }
+
+} // namespace
+
+// ======================= malloc 系列 =======================
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+    return mallocNoThrow(size);
+}
+
+void free(void* p) noexcept {
+    deallocate(p);
+}
+
+void* calloc(size_t n, size_t size) noexcept {
+    size_t bytes;
+    if (__builtin_mul_overflow(n, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    void* p = mallocNoThrow(bytes);
+    if (p) std::memset(p, 0, bytes);
+    return p;
+}
+
+void* realloc(void* p, size_t size) noexcept {
+    if (!p) return mallocNoThrow(size);
+    if (size == 0) {
+        deallocate(p);
+        return nullptr;
+    }
+    try {
+        return GlobalPoolManager::instance().reallocate(p, defaultSize(size));
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+}
+
+void* memalign(size_t align, size_t size) noexcept {
+    return memalignNoThrow(align, size);
+}
+
+void* aligned_alloc(size_t align, size_t size) noexcept {
+    return memalignNoThrow(align, size);
+}
+
+int posix_memalign(void** out, size_t align, size_t size) noexcept {
+    if (align % sizeof(void*) != 0) return EINVAL;
+    void* p = memalignNoThrow(align, size);
+    if (!p) return errno;
+    *out = p;
+    return 0;
+}
+
+void* valloc(size_t size) noexcept {
+    return memalignNoThrow(kPageSize, size);
+}
+
+void* pvalloc(size_t size) noexcept {
+    return memalignNoThrow(kPageSize, (size + kPageSize - 1) & ~(kPageSize - 1));
+}
+
+size_t malloc_usable_size(void* p) noexcept {
+    return p ? GlobalPoolManager::instance().usableSize(p) : 0;
+}
+
+} // extern "C"
+
+// ======================= operator new / delete =======================
+
+void* operator new(size_t size) { return allocateDefault(size); }
+void* operator new[](size_t size) { return allocateDefault(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return mallocNoThrow(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return mallocNoThrow(size); }
+
+void* operator new(size_t size, std::align_val_t align) {
+    return allocateAligned(size, static_cast<size_t>(align));
+}
+void* operator new[](size_t size, std::align_val_t align) {
+    return allocateAligned(size, static_cast<size_t>(align));
+}
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return memalignNoThrow(static_cast<size_t>(align), size);
+}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return memalignNoThrow(static_cast<size_t>(align), size);
+}
+
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
+
+// 带尺寸的释放跳过页映射查找, 直接定位 size-class
+void operator delete(void* p, size_t size) noexcept {
+    if (p) GlobalPoolManager::instance().deallocate(p, defaultSize(size));
+}
+void operator delete[](void* p, size_t size) noexcept {
+    if (p) GlobalPoolManager::instance().deallocate(p, defaultSize(size));
+}
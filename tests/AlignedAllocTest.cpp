@@ -0,0 +1,51 @@
+// ==============================================================
+//                       AlignedAllocTest
+//      0 字节的对齐请求: 不超过一页的对齐得到按 align 对齐的块,
+//      超过一页的对齐也占用独立的 Span, 与随后的分配不重叠
+// ==============================================================
+
+#include <cstdint>
+#include <alloc/MemoryPool.hpp>
+#include "Check.hpp"
+
+namespace {
+
+    bool aligned(const void* p, size_t align) {
+        return reinterpret_cast<uintptr_t>(p) % align == 0;
+    }
+
+    // 尺寸 0 与不是 align 倍数的尺寸, 都要落在按 align 对齐的 size-class 上
+    void testSmallAlignments() {
+        GlobalPoolManager& gpm = GlobalPoolManager::instance();
+        for (size_t align = 16; align <= kPageSize; align *= 2) {
+            for (size_t size : { size_t(0), size_t(1), align - 8, align, align + 8 }) {
+                void* ptrs[16];
+                for (void*& p : ptrs) {
+                    p = gpm.allocateAligned(size, align);
+                    CHECK(aligned(p, align));
+                }
+                for (void* p : ptrs) gpm.deallocateAligned(p, size, align);
+            }
+        }
+    }
+
+    void testZeroSizeOverPageAligned() {
+        GlobalPoolManager& gpm = GlobalPoolManager::instance();
+        for (size_t align : { size_t(8192), size_t(64 * 1024), size_t(2 * 1024 * 1024) }) {
+            void* zero = gpm.allocateAligned(0, align);
+            void* next = gpm.allocateAligned(align, align);
+            CHECK(zero != nullptr && next != nullptr);
+            CHECK(zero != next);
+            CHECK(aligned(zero, align) && aligned(next, align));
+            gpm.deallocateAligned(zero, 0, align);
+            gpm.deallocateAligned(next, align, align);
+        }
+    }
+
+} // namespace
+
+int main() {
+    testSmallAlignments();
+    testZeroSizeOverPageAligned();
+    return 0;
+}
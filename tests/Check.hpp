@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+// 测试用断言: 不受 NDEBUG 影响, 失败时打印位置并退出
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            std::exit(1);                                                               \
+        }                                                                               \
+    } while (0)
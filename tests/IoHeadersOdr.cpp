@@ -0,0 +1,20 @@
+// ==============================================================
+//                        IoHeadersOdr
+//      io 头文件被两个翻译单元包含后仍能链接: 头文件中的
+//      类外定义必须是 inline。另一个单元见 IoHeadersOdrOther.cpp
+// ==============================================================
+
+#include <io/Buffer.hpp>
+#include <io/BufferChain.hpp>
+#include <io/OutputQueue.hpp>
+#include <io/RingBuffer.hpp>
+#include "Check.hpp"
+
+size_t otherUnitBytes();
+
+int main() {
+    hspd::Buffer buffer;
+    buffer.append("main", 4);
+    CHECK(buffer.readableBytes() + otherUnitBytes() == 9);
+    return 0;
+}
@@ -0,0 +1,13 @@
+// IoHeadersOdr 的第二个翻译单元
+#include <io/Buffer.hpp>
+#include <io/BufferChain.hpp>
+#include <io/OutputQueue.hpp>
+#include <io/RingBuffer.hpp>
+
+size_t otherUnitBytes() {
+    hspd::OutputQueue queue;
+    hspd::Buffer buffer;
+    buffer.append("other", 5);
+    queue.append(std::move(buffer));
+    return queue.pendingBytes();
+}
@@ -0,0 +1,119 @@
+// ==============================================================
+//                        ObjectPoolTest
+//      归还的对象经 reset() 缓存并被下一次 acquire() 复用;
+//      reset() 抛出时对象被销毁而不是缓存; 内存压力回调按级别收缩空闲对象
+// ==============================================================
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <alloc/ObjectPool.hpp>
+#include "Check.hpp"
+
+using namespace hspd;
+
+namespace {
+
+    struct Conn {
+        static inline int live = 0;
+        static inline bool failReset = false;
+
+        std::string buf;
+        int resets = 0;
+        int id = 0;
+
+        Conn() { live++; }
+        explicit Conn(int i) : id(i) { live++; }
+        ~Conn() { live--; }
+
+        void reset() {
+            resets++;
+            buf.clear();
+            if (failReset) throw std::runtime_error("reset failed");
+        }
+        void reset(int i) {
+            reset();
+            id = i;
+        }
+    };
+
+    template <typename F>
+    bool waitFor(F&& pred) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!pred()) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    void testReuse() {
+        ObjectPool<Conn> pool(4);
+        Conn* first;
+        {
+            auto c = pool.acquire(1);
+            first = c.get();
+            c->buf.assign(1000, 'x');
+        }
+        CHECK(pool.idleCount() == 1);
+        CHECK(Conn::live == 1);
+
+        auto c = pool.acquire(2);
+        CHECK(c.get() == first);
+        CHECK(c->id == 2);
+        CHECK(c->resets == 2);             // 归还时一次, 带参数复用时一次
+        CHECK(c->buf.empty() && c->buf.capacity() >= 1000);
+        CHECK(pool.idleCount() == 0);
+        c.reset();
+
+        // 超过 maxIdle 的对象直接销毁
+        {
+            ObjectPool<Conn>::Ptr all[6];
+            for (auto& p : all) p = pool.acquire();
+            CHECK(Conn::live == 6);
+        }
+        CHECK(pool.idleCount() == 4);
+        CHECK(Conn::live == 4);
+    }
+
+    void testThrowingReset() {
+        ObjectPool<Conn> pool(4);
+        auto c = pool.acquire();
+        Conn::failReset = true;
+        c.reset();                          // 删除器内 reset() 抛出: 不能终止进程
+        Conn::failReset = false;
+        CHECK(pool.idleCount() == 0);
+        CHECK(Conn::live == 0);
+    }
+
+    void testBudgetShrink() {
+        ObjectPool<Conn> pool(8);
+        {
+            ObjectPool<Conn>::Ptr all[8];
+            for (auto& p : all) p = pool.acquire();
+        }
+        CHECK(pool.idleCount() == 8);
+
+        // 低水位为 0: 立即处于 Moderate, 空闲对象减半
+        MemoryBudget& budget = MemoryBudget::instance();
+        budget.setLimit(size_t(1) << 40, 0.0, 1.0);
+        CHECK(waitFor([&] { return pool.idleCount() == 4; }));
+        CHECK(Conn::live == 4);
+
+        // 两条水位都为 0: Critical, 全部清空
+        budget.setLimit(size_t(1) << 40, 0.0, 0.0);
+        CHECK(waitFor([&] { return pool.idleCount() == 0; }));
+        CHECK(Conn::live == 0);
+        budget.stop();
+    }
+
+} // namespace
+
+int main() {
+    testReuse();
+    CHECK(Conn::live == 0);
+    testThrowingReset();
+    testBudgetShrink();
+    return 0;
+}
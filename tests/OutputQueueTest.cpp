@@ -0,0 +1,117 @@
+// ==============================================================
+//                       OutputQueueTest
+//      依次追加字面量、Buffer、BufferChain、std::string 与文件区间,
+//      经 socketpair 发出后逐字节核对; 移动后的队列与大量分段的队列同样完整发出
+// ==============================================================
+
+#include <cerrno>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <io/OutputQueue.hpp>
+#include "Check.hpp"
+
+using namespace hspd;
+
+namespace {
+
+    std::string pattern(size_t n, char seed) {
+        std::string s(n, '\0');
+        for (size_t i = 0; i < n; i++) s[i] = static_cast<char>(seed + i % 23);
+        return s;
+    }
+
+    // 交替写出与读取, 直到队列发完; 返回对端收到的全部字节
+    std::string drain(OutputQueue& q, int out, int in) {
+        std::string received;
+        char buf[16 * 1024];
+        while (!q.empty()) {
+            int err = 0;
+            ssize_t n = q.writeFd(out, &err);
+            CHECK(n >= 0 || err == EAGAIN);
+            for (;;) {
+                ssize_t r = ::read(in, buf, sizeof(buf));
+                if (r <= 0) break;
+                received.append(buf, static_cast<size_t>(r));
+            }
+        }
+        CHECK(q.pendingBytes() == 0);
+        return received;
+    }
+
+} // namespace
+
+int main() {
+    int sv[2];
+    CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    CHECK(::fcntl(sv[0], F_SETFL, O_NONBLOCK) == 0);
+    CHECK(::fcntl(sv[1], F_SETFL, O_NONBLOCK) == 0);
+
+    int file = ::memfd_create("output-queue-test", MFD_CLOEXEC);
+    CHECK(file >= 0);
+    std::string fileData = pattern(100 * 1024, 'f');
+    CHECK(::write(file, fileData.data(), fileData.size()) == static_cast<ssize_t>(fileData.size()));
+
+    OutputQueue q;
+    std::string expected;
+
+    q.append("HTTP/1.1 200 OK\r\n");
+    q.append("Content-Type: text/plain\r\n\r\n");
+    expected += "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n";
+
+    Buffer small;
+    small.append("small buffer;");
+    expected += "small buffer;";
+    q.append(std::move(small));
+
+    std::string bigBufferData = pattern(8000, 'b');
+    Buffer big;
+    big.append(bigBufferData);
+    expected += bigBufferData;
+    q.append(std::move(big));
+
+    std::string chainData = pattern(40 * 1024, 'c');
+    BufferChain chain;
+    chain.append(chainData);
+    expected += chainData;
+    q.append(std::move(chain));
+
+    std::string str = pattern(3000, 's');
+    expected += str;
+    q.append(std::string(str));
+    q.append(std::string("tiny string;"));
+    expected += "tiny string;";
+
+    q.appendFile(file, 1000, 50 * 1024);
+    expected += fileData.substr(1000, 50 * 1024);
+
+    q.append("trailer\r\n");
+    expected += "trailer\r\n";
+
+    CHECK(q.pendingBytes() == expected.size());
+    static_assert(std::is_nothrow_move_constructible_v<OutputQueue>);
+    OutputQueue moved(std::move(q));
+    CHECK(q.empty() && q.pendingBytes() == 0);
+    CHECK(drain(moved, sv[0], sv[1]) == expected);
+
+    // 分段数远超一次 writev 的上限, 发送过程中已发出的段被整体前移
+    expected.clear();
+    for (int i = 0; i < 2000; i++) {
+        std::string part = pattern(1500 + i % 700, static_cast<char>('A' + i % 26));
+        expected += part;
+        moved.append(std::move(part));
+        if (i % 300 == 299) {
+            q = std::move(moved);
+            moved = std::move(q);
+        }
+    }
+    CHECK(drain(moved, sv[0], sv[1]) == expected);
+
+    ::close(file);
+    ::close(sv[0]);
+    ::close(sv[1]);
+    return 0;
+}
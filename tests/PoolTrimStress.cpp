@@ -0,0 +1,61 @@
+// ==============================================================
+//                       PoolTrimStress
+//      多个线程反复分配/释放同一 size-class, 另有线程不停调用
+//      GlobalPoolManager::trim(): 新切分的 chunk 在第一批被取走之前
+//      不能被回收, 否则补充得到空链表。参数 percpu 时使用每 CPU 缓存;
+//      工作线程数是核数的 4 倍, 持有 CPU 缓存锁的线程会被同一 CPU 上的其他线程抢占
+// ==============================================================
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <alloc/MemoryPool.hpp>
+#include "Check.hpp"
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "percpu") ThreadSafeMemoryPool::setPerCpuCaches(true);
+
+    constexpr size_t kSize = 4096;
+    constexpr int kTrimmers = 2;
+    constexpr int kTotalRounds = 18000;
+    constexpr int kLive = 64;
+    const int kWorkers = std::max(6, 4 * static_cast<int>(std::thread::hardware_concurrency()));
+    const int kRounds = std::max(100, kTotalRounds / kWorkers);
+
+    GlobalPoolManager& gpm = GlobalPoolManager::instance();
+    std::atomic<bool> done{ false };
+    std::vector<std::thread> trimmers;
+    for (int t = 0; t < kTrimmers; t++) {
+        trimmers.emplace_back([&] {
+            while (!done.load(std::memory_order_relaxed)) gpm.trim();
+        });
+    }
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < kWorkers; t++) {
+        workers.emplace_back([&gpm, t, kRounds] {
+            void* live[kLive];
+            for (int r = 0; r < kRounds; r++) {
+                for (int i = 0; i < kLive; i++) {
+                    live[i] = gpm.allocate(kSize);
+                    CHECK(live[i] != nullptr);
+                    std::memset(live[i], t, kSize);
+                }
+                for (int i = 0; i < kLive; i++) {
+                    CHECK(static_cast<unsigned char*>(live[i])[kSize - 1] == static_cast<unsigned char>(t));
+                    gpm.deallocate(live[i], kSize);
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    done.store(true, std::memory_order_relaxed);
+    for (auto& t : trimmers) t.join();
+
+    // 全部归还后整个池都可以回收
+    gpm.trim();
+    return 0;
+}